@@ -0,0 +1,177 @@
+// Throughput benchmark for the hashing functions from Hash.h.
+// Runs on a desktop, not on the microcontroller.
+//
+// Build from the root of the library:
+//
+//   gcc -O2 -Isrc -Iextras/bench -c src/utility/*.c src/utility/trezor/*.c
+//   g++ -O2 -Isrc -Iextras/bench extras/bench/hash_bench.cpp src/*.cpp *.o -o hash_bench
+//
+// Usage: hash_bench [min_ms] [function]
+//   min_ms   - minimal time spent on every measurement, 200 ms by default
+//   function - run only the function with this name
+//
+// Results are printed as CSV, one line per measurement:
+//   function,backend,size,iterations,seconds,bytes_per_s,msgs_per_s
+//
+// Functions using SHA-256 are measured with every SHA-256 transform
+// available on this CPU (backend column), others report "default".
+// Streaming classes are fed with 64-byte writes.
+#include "Hash.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <chrono>
+
+typedef void (*bench_fn)(const uint8_t * data, size_t len, uint8_t * out);
+
+static const uint8_t hmacKey[32] = {
+    0x0b, 0x0b, 0x0b, 0x0b, 0x0b, 0x0b, 0x0b, 0x0b,
+    0x0b, 0x0b, 0x0b, 0x0b, 0x0b, 0x0b, 0x0b, 0x0b,
+    0x0b, 0x0b, 0x0b, 0x0b, 0x0b, 0x0b, 0x0b, 0x0b,
+    0x0b, 0x0b, 0x0b, 0x0b, 0x0b, 0x0b, 0x0b, 0x0b
+};
+
+static void benchSha256(const uint8_t * data, size_t len, uint8_t * out){
+    sha256(data, len, out);
+}
+static void benchDoubleSha(const uint8_t * data, size_t len, uint8_t * out){
+    doubleSha(data, len, out);
+}
+static void benchHash160(const uint8_t * data, size_t len, uint8_t * out){
+    hash160(data, len, out);
+}
+static void benchRmd160(const uint8_t * data, size_t len, uint8_t * out){
+    rmd160(data, len, out);
+}
+static void benchSha512(const uint8_t * data, size_t len, uint8_t * out){
+    sha512(data, len, out);
+}
+static void benchSha256Hmac(const uint8_t * data, size_t len, uint8_t * out){
+    sha256Hmac(hmacKey, sizeof(hmacKey), data, len, out);
+}
+static void benchSha512Hmac(const uint8_t * data, size_t len, uint8_t * out){
+    sha512Hmac(hmacKey, sizeof(hmacKey), data, len, out);
+}
+static void feed(HashAlgorithm * h, const uint8_t * data, size_t len){
+    for(size_t i = 0; i < len; i += 64){
+        h->write(data+i, (len-i < 64) ? (len-i) : 64);
+    }
+}
+static void benchSHA256Class(const uint8_t * data, size_t len, uint8_t * out){
+    SHA256 h;
+    feed(&h, data, len);
+    h.end(out);
+}
+static void benchDoubleShaClass(const uint8_t * data, size_t len, uint8_t * out){
+    DoubleSha h;
+    feed(&h, data, len);
+    h.end(out);
+}
+
+struct BenchEntry{
+    const char * name;
+    bench_fn fn;
+    bool usesSha256;
+};
+
+static const BenchEntry entries[] = {
+    { "sha256",     benchSha256,         true  },
+    { "doubleSha",  benchDoubleSha,      true  },
+    { "hash160",    benchHash160,        true  },
+    { "rmd160",     benchRmd160,         false },
+    { "sha512",     benchSha512,         false },
+    { "sha256Hmac", benchSha256Hmac,     true  },
+    { "sha512Hmac", benchSha512Hmac,     false },
+    { "SHA256",     benchSHA256Class,    true  },
+    { "DoubleSha",  benchDoubleShaClass, true  },
+};
+
+static const size_t sizes[] = { 32, 64, 256, 1024, 4096, 65536, 1048576 };
+
+struct Backend{
+    const char * name;
+    int transform;
+};
+
+static const Backend backends[] = {
+    { "generic", SHA256_TRANSFORM_GENERIC },
+    { "shani",   SHA256_TRANSFORM_SHANI   },
+};
+
+// keeps the compiler from dropping the hashing calls
+static volatile uint8_t sink;
+
+static double now(){
+    return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+static void measure(const BenchEntry * e, const char * backend, const uint8_t * data, size_t len, double minTime){
+    uint8_t out[64];
+    // warm up and find the number of iterations that takes at least minTime
+    size_t iterations = 1;
+    double elapsed = 0;
+    while(true){
+        double start = now();
+        for(size_t i = 0; i < iterations; i++){
+            e->fn(data, len, out);
+            sink ^= out[0];
+        }
+        elapsed = now() - start;
+        if(elapsed >= minTime){
+            break;
+        }
+        // aim a bit above the limit to avoid one more round
+        size_t next = (elapsed > 0) ? (size_t)(iterations * 1.2 * minTime / elapsed) : iterations * 10;
+        iterations = (next > iterations) ? next : iterations * 2;
+    }
+    printf("%s,%s,%lu,%lu,%.6f,%.0f,%.0f\n", e->name, backend,
+            (unsigned long)len, (unsigned long)iterations, elapsed,
+            (double)len * iterations / elapsed, iterations / elapsed);
+    fflush(stdout);
+}
+
+int main(int argc, char ** argv){
+    double minTime = 0.2;
+    const char * filter = NULL;
+    if(argc > 1){
+        minTime = atof(argv[1]) / 1000.0;
+    }
+    if(argc > 2){
+        filter = argv[2];
+    }
+    size_t maxSize = sizes[sizeof(sizes)/sizeof(sizes[0])-1];
+    uint8_t * data = (uint8_t *)malloc(maxSize);
+    if(data == NULL){
+        return 1;
+    }
+    for(size_t i = 0; i < maxSize; i++){
+        data[i] = (uint8_t)(i * 131 + 7);
+    }
+    int defaultTransform = sha256_GetTransform();
+
+    printf("function,backend,size,iterations,seconds,bytes_per_s,msgs_per_s\n");
+    for(size_t k = 0; k < sizeof(entries)/sizeof(entries[0]); k++){
+        const BenchEntry * e = &entries[k];
+        if(filter != NULL && strcmp(filter, e->name) != 0){
+            continue;
+        }
+        for(size_t b = 0; b < sizeof(backends)/sizeof(backends[0]); b++){
+            const char * backend = "default";
+            if(e->usesSha256){
+                if(!sha256_SetTransform(backends[b].transform)){
+                    continue; // not supported by this CPU or build
+                }
+                backend = backends[b].name;
+            }else if(b > 0){
+                break;
+            }
+            for(size_t s = 0; s < sizeof(sizes)/sizeof(sizes[0]); s++){
+                measure(e, backend, data, sizes[s], minTime);
+            }
+        }
+        sha256_SetTransform(defaultTransform);
+    }
+    free(data);
+    return 0;
+}
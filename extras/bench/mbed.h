@@ -0,0 +1,2 @@
+/* Empty stand-in for mbed.h, lets the library build on a desktop
+ * with the default (non-Arduino) configuration from uBitcoin_conf.h */
@@ -0,0 +1,289 @@
+#include "AddressPool.h"
+
+#include <stdint.h>
+#include <string.h>
+
+#if USE_STD_THREAD
+#include <chrono>
+#define POOL_LOCK()   lock.lock()
+#define POOL_UNLOCK() lock.unlock()
+#else
+#define POOL_LOCK()
+#define POOL_UNLOCK()
+#endif
+
+static const uint32_t defaultChains[] = { 0, 1 };
+
+AddressPool::AddressPool(){
+    chainKeys = NULL;
+    accountsLen = 0;
+    chains = NULL;
+    chainsLen = 0;
+    lookahead = 0;
+    type = UNKNOWN_TYPE;
+    rings = NULL;
+    records = NULL;
+    memset(&counters, 0, sizeof(counters));
+#if USE_STD_THREAD
+    running = false;
+    pending = false;
+#endif
+}
+AddressPool::~AddressPool(){
+    end();
+}
+bool AddressPool::begin(const HDPublicKey * accs, size_t accsLen, uint32_t look,
+                        ScriptType scriptType, const uint32_t * chainsArr, size_t chainsArrLen){
+    end();
+    if(chainsArr == NULL){
+        chainsArr = defaultChains;
+        chainsArrLen = sizeof(defaultChains)/sizeof(defaultChains[0]);
+    }
+    if(accs == NULL || accsLen == 0 || chainsArrLen == 0 || look == 0){
+        return false;
+    }
+    for(size_t i = 0; i < chainsArrLen; i++){
+        if(chainsArr[i] >= 0x80000000){
+            return false;
+        }
+    }
+    size_t n = accsLen * chainsArrLen;
+    chainKeys = new HDPublicKey[n];
+    chains = new uint32_t[chainsArrLen];
+    rings = new Ring[n];
+    records = new ScanRecord[n * look];
+    // chain keys are derived once, refills derive only the addresses
+    for(size_t i = 0; i < n; i++){
+        chainKeys[i] = accs[i / chainsArrLen].child(chainsArr[i % chainsArrLen]);
+    }
+    memcpy(chains, chainsArr, chainsArrLen * sizeof(uint32_t));
+    memset(rings, 0, n * sizeof(Ring));
+    accountsLen = accsLen;
+    chainsLen = chainsArrLen;
+    lookahead = look;
+    type = scriptType;
+    memset(&counters, 0, sizeof(counters));
+    counters.capacity = n * look;
+    counters.minAvailable = look;
+    return true;
+}
+void AddressPool::end(){
+#if USE_STD_THREAD
+    stopRefill();
+#endif
+    delete[] chainKeys;
+    delete[] chains;
+    delete[] rings;
+    delete[] records;
+    chainKeys = NULL;
+    chains = NULL;
+    rings = NULL;
+    records = NULL;
+    accountsLen = 0;
+    chainsLen = 0;
+    lookahead = 0;
+    memset(&counters, 0, sizeof(counters));
+}
+// ring number for the account and chain, -1 if there is no such chain
+int AddressPool::ring(size_t account, uint32_t chain) const{
+    if(account >= accountsLen){
+        return -1;
+    }
+    for(size_t i = 0; i < chainsLen; i++){
+        if(chains[i] == chain){
+            return account * chainsLen + i;
+        }
+    }
+    return -1;
+}
+bool AddressPool::setNextIndex(size_t account, uint32_t chain, uint32_t index){
+    if(index >= 0x80000000){
+        return false;
+    }
+    POOL_LOCK();
+    int r = ring(account, chain);
+    if(r >= 0){
+        counters.available -= rings[r].fill;
+        rings[r].head = 0;
+        rings[r].fill = 0;
+        rings[r].nextIndex = index;
+        rings[r].epoch++;
+    }
+    POOL_UNLOCK();
+    return (r >= 0);
+}
+
+// derives a single address without the refill scratch, used on misses
+void AddressPool::deriveOne(size_t r, uint32_t index, ScanRecord * record) const{
+    HDPublicKey key;
+    uint8_t sec[33];
+    uint8_t hash[20];
+    ScanScratch s;
+    s.keys = &key;
+    s.secs = sec;
+    s.hashes = hash;
+    s.capacity = 1;
+    deriveRecords(chainKeys[r], r / chainsLen, index, index+1, type, &s, record);
+}
+// derives addresses of the ring if it has `threshold` or less of them.
+// The range following the pre-derived addresses is reserved under the lock
+// and derived without it, so next() is not blocked. Addresses next() handed out
+// meanwhile are skipped when the range is stored, the rest of the range is kept.
+size_t AddressPool::refillRing(size_t r, uint32_t threshold, ScanScratch * scratch, ScanRecord * derived){
+    POOL_LOCK();
+    Ring * cur = &rings[r];
+    if(cur->busy || cur->fill > threshold){
+        POOL_UNLOCK();
+        return 0;
+    }
+    uint32_t from = cur->nextIndex + cur->fill;
+    uint32_t n = lookahead - cur->fill;
+    if((uint64_t)from + n > 0x80000000){
+        n = 0x80000000 - from;
+    }
+    if(n == 0){
+        POOL_UNLOCK();
+        return 0;
+    }
+    uint32_t epoch = cur->epoch;
+    cur->busy = true;
+    POOL_UNLOCK();
+
+    size_t count = deriveRecords(chainKeys[r], r / chainsLen, from, from+n, type, scratch, derived);
+
+    POOL_LOCK();
+    cur->busy = false;
+    uint32_t stored = 0;
+    // after setNextIndex() the range belongs to another position of the chain
+    if(count == n && cur->epoch == epoch){
+        // pre-derived addresses always end at `from`, misses move nextIndex past it
+        uint32_t skip = cur->nextIndex + cur->fill - from;
+        ScanRecord * arr = records + r * lookahead;
+        for(uint32_t i = skip; i < n && cur->fill < lookahead; i++){
+            arr[(cur->head + cur->fill) % lookahead] = derived[i];
+            cur->fill++;
+            stored++;
+        }
+        counters.available += stored;
+    }
+    POOL_UNLOCK();
+    return stored;
+}
+size_t AddressPool::refillAll(uint32_t threshold){
+#if USE_STD_THREAD
+    std::chrono::steady_clock::time_point t0 = std::chrono::steady_clock::now();
+#endif
+    ScanScratch scratch;
+    ScanRecord * derived = new ScanRecord[lookahead];
+    size_t total = 0;
+    if(derived != NULL && scanScratchInit(&scratch, lookahead)){
+        for(size_t r = 0; r < accountsLen * chainsLen; r++){
+            total += refillRing(r, threshold, &scratch, derived);
+        }
+    }
+    scanScratchFree(&scratch);
+    delete[] derived;
+    if(total > 0){
+        POOL_LOCK();
+        counters.refills++;
+#if USE_STD_THREAD
+        uint64_t us = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - t0).count();
+        counters.lastRefillUs = (uint32_t)us;
+        if(counters.lastRefillUs > counters.maxRefillUs){
+            counters.maxRefillUs = counters.lastRefillUs;
+        }
+        counters.totalRefillUs += us;
+#endif
+        POOL_UNLOCK();
+    }
+    return total;
+}
+size_t AddressPool::refill(){
+    if(rings == NULL){
+        return 0;
+    }
+    return refillAll(lookahead - 1);
+}
+bool AddressPool::next(size_t account, uint32_t chain, ScanRecord * record){
+    POOL_LOCK();
+    int r = ring(account, chain);
+    if(r < 0 || rings[r].nextIndex >= 0x80000000){
+        POOL_UNLOCK();
+        return false;
+    }
+    Ring * cur = &rings[r];
+    bool hit = (cur->fill > 0);
+    uint32_t index = cur->nextIndex;
+    cur->nextIndex++;
+    if(hit){
+        *record = records[r * lookahead + cur->head];
+        cur->head = (cur->head + 1) % lookahead;
+        cur->fill--;
+        counters.available--;
+    }else{
+        counters.misses++;
+    }
+    counters.issued++;
+    if(cur->fill < counters.minAvailable){
+        counters.minAvailable = cur->fill;
+    }
+#if USE_STD_THREAD
+    if(running && cur->fill <= lookahead / 2){
+        pending = true;
+        wakeup.notify_one();
+    }
+#endif
+    POOL_UNLOCK();
+    if(!hit){
+        deriveOne(r, index, record);
+    }
+    return true;
+}
+size_t AddressPool::available(size_t account, uint32_t chain) const{
+    POOL_LOCK();
+    int r = ring(account, chain);
+    size_t n = (r < 0) ? 0 : rings[r].fill;
+    POOL_UNLOCK();
+    return n;
+}
+AddressPoolStats AddressPool::stats() const{
+    POOL_LOCK();
+    AddressPoolStats s = counters;
+    POOL_UNLOCK();
+    return s;
+}
+#if USE_STD_THREAD
+void AddressPool::work(){
+    // fills everything at start, later only chains that are half-empty
+    uint32_t threshold = lookahead - 1;
+    while(true){
+        refillAll(threshold);
+        threshold = lookahead / 2;
+        std::unique_lock<std::mutex> guard(lock);
+        wakeup.wait(guard, [this]{ return pending || !running; });
+        if(!running){
+            break;
+        }
+        pending = false;
+    }
+}
+bool AddressPool::startRefill(){
+    if(rings == NULL || worker.joinable()){
+        return false;
+    }
+    running = true;
+    pending = false;
+    worker = std::thread(&AddressPool::work, this);
+    return true;
+}
+void AddressPool::stopRefill(){
+    if(!worker.joinable()){
+        return;
+    }
+    lock.lock();
+    running = false;
+    wakeup.notify_one();
+    lock.unlock();
+    worker.join();
+}
+#endif
@@ -0,0 +1,110 @@
+#ifndef __ADDRESS_POOL_H__
+#define __ADDRESS_POOL_H__
+
+#include "Bitcoin.h"
+#include "Scanner.h"
+
+#if USE_STD_THREAD
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#endif
+
+/** \brief Counters of the AddressPool, refill times are measured only with USE_STD_THREAD */
+typedef struct{
+    /** \brief total number of slots: accounts * chains * lookahead */
+    size_t capacity;
+    /** \brief number of pre-derived addresses in the pool */
+    size_t available;
+    /** \brief lowest number of addresses left in a chain after a hand-out */
+    size_t minAvailable;
+    /** \brief addresses handed out by next() */
+    size_t issued;
+    /** \brief addresses derived in next() because the chain was empty */
+    size_t misses;
+    /** \brief number of refills that derived at least one address */
+    size_t refills;
+    uint32_t lastRefillUs;
+    uint32_t maxRefillUs;
+    uint64_t totalRefillUs;
+} AddressPoolStats;
+
+/**
+ *  \brief Keeps `lookahead` pre-derived addresses for every chain of every account
+ *         and hands them out in O(1). The pool is topped up by refill()
+ *         or, with USE_STD_THREAD, by a background thread started with startRefill().
+ *         Chains are refilled when half of the lookahead is used.
+ */
+class AddressPool{
+protected:
+    typedef struct{
+        /** \brief position of the first pre-derived address in the ring */
+        uint32_t head;
+        /** \brief number of pre-derived addresses, they have indexes from nextIndex */
+        uint32_t fill;
+        /** \brief index of the address next() hands out */
+        uint32_t nextIndex;
+        /** \brief incremented by setNextIndex(), refills started before are dropped */
+        uint32_t epoch;
+        /** \brief a refill derives addresses following the pre-derived ones */
+        bool busy;
+    } Ring;
+
+    /** \brief account/chain keys, one per ring */
+    HDPublicKey * chainKeys;
+    size_t accountsLen;
+    uint32_t * chains;
+    size_t chainsLen;
+    uint32_t lookahead;
+    ScriptType type;
+    Ring * rings;
+    ScanRecord * records;
+    AddressPoolStats counters;
+
+    int ring(size_t account, uint32_t chain) const;
+    size_t refillRing(size_t r, uint32_t threshold, ScanScratch * scratch, ScanRecord * derived);
+    size_t refillAll(uint32_t threshold);
+    void deriveOne(size_t r, uint32_t index, ScanRecord * record) const;
+#if USE_STD_THREAD
+    mutable std::mutex lock;
+    std::condition_variable wakeup;
+    std::thread worker;
+    bool running;
+    bool pending;
+    void work();
+#endif
+public:
+    AddressPool();
+    ~AddressPool();
+    AddressPool(const AddressPool &other) = delete;
+    AddressPool &operator=(const AddressPool &other) = delete;
+
+    /** \brief sets up the pool for the accounts, chains can be NULL - receive and change chains (0 and 1).
+     *         If type is UNKNOWN_TYPE the type of every account is used.
+     *         Addresses start from index 0, use setNextIndex() to continue from the last used one.
+     *         The pool is empty until refilled.
+     */
+    bool begin(const HDPublicKey * accounts, size_t accountsLen, uint32_t lookahead = 20,
+               ScriptType type = UNKNOWN_TYPE, const uint32_t * chains = NULL, size_t chainsLen = 0);
+    /** \brief stops the refill thread and frees memory */
+    void end();
+    /** \brief drops pre-derived addresses of the chain, next address will have this index */
+    bool setNextIndex(size_t account, uint32_t chain, uint32_t index);
+    /** \brief hands out the next unused address of the chain.
+     *         If the chain is empty the address is derived immediately and counted as a miss.
+     */
+    bool next(size_t account, uint32_t chain, ScanRecord * record);
+    /** \brief fills every chain up to the lookahead in the calling thread, returns number of derived addresses */
+    size_t refill();
+    /** \brief number of pre-derived addresses of the chain */
+    size_t available(size_t account, uint32_t chain) const;
+    AddressPoolStats stats() const;
+#if USE_STD_THREAD
+    /** \brief starts a thread refilling chains in the background */
+    bool startRefill();
+    /** \brief stops the refill thread */
+    void stopRefill();
+#endif
+};
+
+#endif // __ADDRESS_POOL_H__
@@ -273,13 +273,50 @@ void Signature::fromBin(const uint8_t * arr, size_t len){
 }
 // ---------------------------------------------------------------- PublicKey class
 
+PublicKey::PublicKey(const PublicKey& other):ECPoint(other){
+    hashState = LAZY_EMPTY;
+    if(lazyReady(&other.hashState)){
+        memcpy(hashCache, other.hashCache, 20);
+        hashState = LAZY_READY;
+    }
+}
+PublicKey &PublicKey::operator=(const PublicKey& other){
+    if(this == &other){
+        return *this;
+    }
+    ECPoint::operator=(other);
+    hashState = LAZY_EMPTY;
+    // other may be hashing in another thread right now
+    if(lazyReady(&other.hashState)){
+        memcpy(hashCache, other.hashCache, 20);
+        hashState = LAZY_READY;
+    }
+    return *this;
+}
+size_t PublicKey::from_stream(ParseStream *s){
+    hashState = LAZY_EMPTY;
+    return ECPoint::from_stream(s);
+}
+void PublicKey::keyHash(uint8_t hash[20]) const{
+    uint8_t sec_arr[65];
+    if(!compressed){
+        int l = sec(sec_arr, sizeof(sec_arr));
+        hash160(sec_arr, l, hash);
+        return;
+    }
+    if(lazyStart(&hashState)){
+        sec_arr[0] = 0x02 + (point[63] & 0x01);
+        memcpy(sec_arr+1, point, 32);
+        hash160(sec_arr, 33, hashCache);
+        lazyFinish(&hashState);
+    }
+    memcpy(hash, hashCache, 20);
+}
 int PublicKey::legacyAddress(char * address, size_t len, const Network * network) const{
     memset(address, 0, len);
 
     uint8_t buffer[20];
-    uint8_t sec_arr[65] = { 0 };
-    int l = sec(sec_arr, sizeof(sec_arr));
-    hash160(sec_arr, l, buffer);
+    keyHash(buffer);
 
     uint8_t addr[21];
     addr[0] = network->p2pkh;
@@ -307,9 +344,7 @@ int PublicKey::segwitAddress(char address[], size_t len, const Network * network
         return 0;
     }
     uint8_t hash[20];
-    uint8_t sec_arr[65] = { 0 };
-    int l = sec(sec_arr, sizeof(sec_arr));
-    hash160(sec_arr, l, hash);
+    keyHash(hash);
     segwit_addr_encode(address, network->bech32, 0, hash, 20);
     return 76;
 }
@@ -332,9 +367,7 @@ int PublicKey::nestedSegwitAddress(char address[], size_t len, const Network * n
     uint8_t script[22] = { 0 };
     script[0] = 0x00;
     script[1] = 0x14;
-    uint8_t sec_arr[65] = { 0 };
-    int l = sec(sec_arr, sizeof(sec_arr));
-    hash160(sec_arr, l, script+2);
+    keyHash(script+2);
 
     uint8_t addr[21];
     addr[0] = network->p2sh;
@@ -392,7 +425,7 @@ size_t PrivateKey::from_stream(ParseStream *s){
         bn_read_be(num, &n);
         bn_mod(&n, &secp256k1.order);
         bn_write_be(&n, num);
-        pubKey = *this * GeneratorPoint;
+        invalidatePublicKey();
     }
     bytes_parsed += bytes_read;
     return bytes_read;
@@ -400,15 +433,40 @@ size_t PrivateKey::from_stream(ParseStream *s){
 PrivateKey::PrivateKey(void){
     reset();
     memset(num, 0, 32); // empty key
+    pubKeyState = LAZY_READY; // default pubKey is fine for empty key
     network = &DEFAULT_NETWORK;
 }
 PrivateKey::PrivateKey(const uint8_t * secret_arr, bool use_compressed, const Network * net){
     reset();
     memcpy(num, secret_arr, 32);
     network = net;
-    pubKey = *this * GeneratorPoint;
+    invalidatePublicKey();
     pubKey.compressed = use_compressed;
 }
+PrivateKey::PrivateKey(const PrivateKey& other):ECScalar(other){
+    network = other.network;
+    copyPublicKey(other);
+}
+PrivateKey &PrivateKey::operator=(const PrivateKey& other){
+    if(this == &other){
+        return *this;
+    }
+    ECScalar::operator=(other);
+    network = other.network;
+    copyPublicKey(other);
+    return *this;
+}
+void PrivateKey::copyPublicKey(const PrivateKey& other){
+    // other may be computing its key in another thread right now,
+    // the point is read only after it is published
+    if(lazyReady(&other.pubKeyState)){
+        pubKey = other.pubKey;
+        pubKeyState = LAZY_READY;
+    }else{
+        pubKey.compressed = other.pubKey.compressed;
+        pubKeyState = LAZY_EMPTY;
+    }
+}
 PrivateKey::~PrivateKey(void) {
     reset();
     // erase secret key from memory
@@ -473,7 +531,7 @@ int PrivateKey::fromWIF(const char * wifArr, size_t wifSize){
     memcpy(num, arr+1, 32);
     memset(arr, 0, 40); // clear memory
 
-    pubKey = *this * GeneratorPoint;
+    invalidatePublicKey();
     pubKey.compressed = compressed;
     return 1;
 }
@@ -481,47 +539,70 @@ int PrivateKey::fromWIF(const char * wifArr){
     return fromWIF(wifArr, strlen(wifArr));
 }
 
+void PrivateKey::computePublicKey() const{
+    if(!lazyStart(&pubKeyState)){
+        return;
+    }
+    // only the point is written, compressed flag can be read by copies meanwhile
+    ECPoint p = *this * GeneratorPoint;
+    memcpy(pubKey.point, p.point, 64);
+    pubKey.invalidateHash();
+    lazyFinish(&pubKeyState);
+}
 PublicKey PrivateKey::publicKey() const{
+    computePublicKey();
     return pubKey;
 }
 
 int PrivateKey::address(char * address, size_t len) const{
+    computePublicKey();
     return pubKey.address(address, len, network);
 }
 int PrivateKey::legacyAddress(char * address, size_t len) const{
+    computePublicKey();
     return pubKey.legacyAddress(address, len, network);
 }
 int PrivateKey::segwitAddress(char * address, size_t len) const{
+    computePublicKey();
     return pubKey.segwitAddress(address, len, network);
 }
 int PrivateKey::nestedSegwitAddress(char * address, size_t len) const{
+    computePublicKey();
     return pubKey.nestedSegwitAddress(address, len, network);
 }
 #if USE_ARDUINO_STRING
 String PrivateKey::address() const{
+    computePublicKey();
     return pubKey.address(network);
 }
 String PrivateKey::legacyAddress() const{
+    computePublicKey();
     return pubKey.legacyAddress(network);
 }
 String PrivateKey::segwitAddress() const{
+    computePublicKey();
     return pubKey.segwitAddress(network);
 }
 String PrivateKey::nestedSegwitAddress() const{
+    computePublicKey();
     return pubKey.nestedSegwitAddress(network);
 }
 #endif
 #if USE_STD_STRING
 string PrivateKey::address() const{
+    computePublicKey();
     return pubKey.address(network);
 }
 string PrivateKey::legacyAddress() const{
+    computePublicKey();
     return pubKey.legacyAddress(network);
 }
 string PrivateKey::segwitAddress() const{
+    computePublicKey();
     return pubKey.segwitAddress(network);
 }
 string PrivateKey::nestedSegwitAddress() const{
+    computePublicKey();
     return pubKey.nestedSegwitAddress(network);
 }
 #endif
@@ -539,10 +620,12 @@ Signature PrivateKey::sign(const uint8_t hash[32]) const{
     return sig;
 }
 PrivateKey::PrivateKey(const char * wifArr){
+    pubKeyState = LAZY_READY;
     fromWIF(wifArr);
 }
 #if USE_ARDUINO_STRING
 PrivateKey::PrivateKey(const String wifString){
+    pubKeyState = LAZY_READY;
     fromWIF(wifString.c_str());
 }
 #endif
@@ -82,9 +82,13 @@ enum ScriptType{
 
 /** \brief SigHash types */
 enum SigHashType{
+    /** \brief taproot only, commits to everything like SIGHASH_ALL */
+    SIGHASH_DEFAULT = 0,
     SIGHASH_ALL = 1,
     SIGHASH_NONE = 2,
-    SIGHASH_SINGLE = 3
+    SIGHASH_SINGLE = 3,
+    /** \brief flag, combine with one of the types above */
+    SIGHASH_ANYONECANPAY = 0x80
 };
 
 /* forward declarations */
@@ -95,11 +99,51 @@ class HDPublicKey;
 class HDPrivateKey;
 class Script;
 class TxIn;
+class SchnorrSignature;
+class XOnlyPublicKey;
+class SHA512;
+
+/**
+ *  \brief States of fields that const methods compute on first use.
+ *         Several threads can share a const key: the first one computes the field,
+ *         others wait until it is ready. Non-const methods are not thread-safe.
+ */
+enum LazyState{
+    LAZY_EMPTY = 0,
+    LAZY_BUSY,
+    LAZY_READY
+};
+/** \brief true if the field is ready to be read */
+inline bool lazyReady(const uint8_t * state){ return __atomic_load_n(state, __ATOMIC_ACQUIRE) == LAZY_READY; }
+/** \brief true if the caller has to compute the field and call lazyFinish(),
+ *         false when it is ready (waits if another thread is computing it) */
+inline bool lazyStart(uint8_t * state){
+    uint8_t expected = LAZY_EMPTY;
+    if(lazyReady(state)){
+        return false;
+    }
+    if(__atomic_compare_exchange_n(state, &expected, (uint8_t)LAZY_BUSY, false, __ATOMIC_ACQUIRE, __ATOMIC_ACQUIRE)){
+        return true;
+    }
+    while(!lazyReady(state)){
+    }
+    return false;
+}
+/** \brief publishes the computed field */
+inline void lazyFinish(uint8_t * state){ __atomic_store_n(state, (uint8_t)LAZY_READY, __ATOMIC_RELEASE); }
 
 const char * generateMnemonic(int strength = 128);
 const char * generateMnemonic(const uint8_t * entropy_data, size_t dataLen);
 const char * generateMnemonic(const char * entropy_string);
 bool checkMnemonic(const char * mnemonic);
+/** \brief Converts count mnemonics with passwords to 64-byte seeds (bip39),
+ *         seeds are written one after another. passwords can be NULL (no passwords).
+ *         Several seeds are computed in parallel if the CPU allows it and,
+ *         with USE_STD_THREAD, in `threads` threads (0 - one per CPU core).
+ *         Returns number of seeds, 0 if memory for a salt can't be allocated. */
+size_t mnemonicToSeeds(const char * const * mnemonics, const char * const * passwords, size_t count, uint8_t * seeds, unsigned int threads = 0);
+/** \brief Wipes intermediate HD keys cached by `derive()` (see USE_BIP32_CACHE in options.h). */
+void clearDerivationCache();
 
 /**
  *  PublicKey class.
@@ -111,13 +155,32 @@ bool checkMnemonic(const char * mnemonic);
  *  - `compressed = true` will use 33-byte representation (`03<x>` if y is odd, `02<x>` if y is even)
  */
 class PublicKey : public ECPoint{
+protected:
+    // hash160 of the compressed sec, calculated on first use
+    mutable uint8_t hashCache[20];
+    /** \brief LazyState of hashCache */
+    mutable uint8_t hashState;
+    virtual size_t from_stream(ParseStream *s);
 public:
-    PublicKey():ECPoint(){};
-    PublicKey(const uint8_t pubkeyArr[64], bool use_compressed) : ECPoint(pubkeyArr, use_compressed){};
-    PublicKey(const uint8_t * secArr) : ECPoint(secArr){};
-    explicit PublicKey(const char * secHex) : ECPoint(secHex){};
+    PublicKey():ECPoint(){ hashState = LAZY_EMPTY; };
+    PublicKey(const uint8_t pubkeyArr[64], bool use_compressed) : ECPoint(pubkeyArr, use_compressed){ hashState = LAZY_EMPTY; };
+    PublicKey(const uint8_t * secArr) : ECPoint(secArr){ hashState = LAZY_EMPTY; };
+    explicit PublicKey(const char * secHex) : ECPoint(secHex){ hashState = LAZY_EMPTY; };
     // do I need this?
     PublicKey(ECPoint p){ reset(); compressed=p.compressed; memcpy(point, p.point, 64); };
+    PublicKey(const PublicKey& other);
+    PublicKey &operator=(const PublicKey& other);
+
+    virtual void reset(){ ECPoint::reset(); hashState = LAZY_EMPTY; };
+    ECPoint operator+=(const ECPoint& other){ hashState = LAZY_EMPTY; return ECPoint::operator+=(other); };
+    ECPoint operator-=(const ECPoint& other){ hashState = LAZY_EMPTY; return ECPoint::operator-=(other); };
+    /** \brief Drops the cached hash, call it after writing `point` directly */
+    void invalidateHash(){ hashState = LAZY_EMPTY; };
+    /**
+     *  \brief Writes hash160 of the sec to `hash`. The hash of the compressed key
+     *          is calculated on first use and cached, a const key can be shared between threads.
+     */
+    void keyHash(uint8_t hash[20]) const;
     /**
      *  \brief Populated `addr` with legacy Pay-To-Pubkey-Hash address (P2PKH, `1...` for mainnet)
      */
@@ -154,17 +217,59 @@ public:
      *  \brief Returns a Script with the type: `P2PKH`, `P2WPKH` or `P2SH_P2WPKH`
      */
     Script script(ScriptType type = P2PKH) const;
+    /**
+     *  \brief Returns x-only public key (bip340), the point is negated if y is odd
+     */
+    XOnlyPublicKey xonly() const;
+};
+
+/**
+ *  \brief X-only public key (bip340). Serialized as 32-byte x coordinate,
+ *         the point always has even y.
+ */
+class XOnlyPublicKey : public PublicKey{
+protected:
+    virtual size_t from_stream(ParseStream *s);
+    virtual size_t to_stream(SerializeStream *s, size_t offset = 0) const;
+public:
+    XOnlyPublicKey():PublicKey(){};
+    XOnlyPublicKey(const uint8_t x[32]){ reset(); parse(x, 32); };
+    explicit XOnlyPublicKey(const char * xHex){ reset(); parse(xHex, strlen(xHex)); };
+    /** \brief Drops parity of the point: negates it if y is odd */
+    XOnlyPublicKey(const ECPoint& p);
+    virtual size_t length() const{ return 32; };
+    virtual size_t stringLength() const{ return 64; };
+    /** \brief Verifies bip340 Schnorr signature of the 32-byte message */
+    bool verify(const SchnorrSignature& sig, const uint8_t msg[32]) const;
 };
 
+/**
+ *  \brief Verifies n bip340 signatures at once: sigs[i] of the message msgs+32*i with pubkeys[i].
+ *         All checks are combined with random weights into one multi-scalar multiplication,
+ *         this is much faster than n separate verifications.
+ *         Returns true only if all signatures are valid, verify them one by one
+ *         to find the invalid one. Returns false if memory allocation failed.
+ */
+bool schnorrVerifyBatch(const SchnorrSignature * sigs, const XOnlyPublicKey * pubkeys, const uint8_t * msgs, size_t n);
+
 /**
  *  PrivateKey class.
- *  Corresponding public key (point on curve) will be calculated in the constructor.
- *      as point calculation is pretty slow, class initialization can take some time.
+ *  Corresponding public key (point on curve) is calculated on first use
+ *      and cached, as point calculation is pretty slow.
+ *  Const methods can be called from several threads, the first one calculates the key.
  */
 class PrivateKey : public ECScalar{
 protected:
-    /** \brief corresponding point on curve ( secret * G ) */
-    PublicKey pubKey;
+    /** \brief corresponding point on curve ( secret * G ), calculated lazily */
+    mutable PublicKey pubKey;
+    /** \brief LazyState of pubKey, LAZY_READY if it corresponds to the current secret */
+    mutable uint8_t pubKeyState;
+    /** \brief calculates pubKey if it is not ready yet, keeps compressed flag */
+    void computePublicKey() const;
+    /** \brief marks pubKey as outdated, call it when secret changes */
+    virtual void invalidatePublicKey(){ pubKeyState = LAZY_EMPTY; };
+    /** \brief copies pubKey of the other key only if it is ready */
+    void copyPublicKey(const PrivateKey& other);
     virtual size_t to_str(char * buf, size_t len) const{ return wif( buf, len); };
     virtual size_t from_str(const char * buf, size_t len){ return fromWIF(buf, len); };
     virtual size_t from_stream(ParseStream *s);
@@ -175,11 +280,13 @@ public:
 #if USE_ARDUINO_STRING
     PrivateKey(const String wifString);
 #endif
+    PrivateKey(const PrivateKey& other);
+    PrivateKey &operator=(const PrivateKey& other);
     ~PrivateKey();
     /** \brief Length of the key in WIF format (52). In reality not always 52... */
     virtual size_t stringLength() const{ return 52; };
     virtual size_t length() const{ return 32; };
-    void setSecret(const uint8_t secret_arr[32]){ memcpy(num, secret_arr, 32); pubKey = *this * GeneratorPoint; };
+    void setSecret(const uint8_t secret_arr[32]){ memcpy(num, secret_arr, 32); invalidatePublicKey(); };
 
     /** \brief Pointer to the network to use. Mainnet or Testnet */
     const Network * network;
@@ -199,6 +306,10 @@ public:
     PublicKey publicKey() const;
     /** \brief Signs the hash and returns the Signature */
     Signature sign(const uint8_t hash[32]) const; // pass 32-byte hash of the message here
+    /** \brief Signs the 32-byte message with bip340 Schnorr signature.
+     *         aux is 32 bytes of auxiliary randomness, NULL means 32 zero bytes (deterministic signature).
+     *         Returns an empty signature if the key is invalid. */
+    SchnorrSignature schnorrSign(const uint8_t msg[32], const uint8_t aux[32] = NULL) const;
 
     /** \brief Alias for .publicKey().address(network) */
     int address(char * address, size_t len) const;
@@ -222,6 +333,38 @@ public:
 #endif
 };
 
+/**
+ *  \brief BIP32 derivation path, for example `m/84h/0h/0h/1/23`.
+ *         Parsed once into a fixed array of indexes, hardened indexes have 0x80000000 bit set.
+ *         Accepts `h`, `H` or `'` as hardened marker, leading `m/` and trailing `/` are optional.
+ *         Paths deeper than DERIVATION_PATH_MAX_DEPTH are invalid.
+ */
+class DerivationPath : public Readable{
+protected:
+    virtual size_t to_str(char * buf, size_t len) const;
+    virtual size_t from_str(const char * buf, size_t len);
+    bool valid;
+public:
+    DerivationPath(){ memset(index, 0, sizeof(index)); depth = 0; valid = true; };
+    explicit DerivationPath(const char * path){ from_str(path, strlen(path)); };
+    DerivationPath(const uint32_t * indexes, size_t len);
+
+    uint32_t index[DERIVATION_PATH_MAX_DEPTH];
+    uint8_t depth;
+
+    bool isValid() const{ return valid; };
+    /** \brief true if any of the indexes is hardened */
+    bool isHardened() const;
+    /** \brief appends an index to the path, returns false if the path is full */
+    bool push(uint32_t childIndex);
+    /** \brief true if the path begins with `prefix` */
+    bool startsWith(const DerivationPath& prefix) const;
+    uint32_t operator[](size_t i) const{ return index[i]; };
+    bool operator==(const DerivationPath& other) const;
+    bool operator!=(const DerivationPath& other) const{ return !operator==(other); };
+    virtual size_t stringLength() const;
+};
+
 /**
  *  \brief HD Private Key class. Derived from PrivateKey class.
  *         Works according to [bip32](https://github.com/bitcoin/bips/blob/master/bip-0032.mediawiki),
@@ -229,6 +372,8 @@ public:
  *         [slip32](https://github.com/satoshilabs/slips/blob/master/slip-0032.md).
  *  You can generate the key from mnemonic or seed, derive children and hardened children.
  *  xprv and xpub methods return strings according to slip32, xprv/xpub for bip44, yprv/ypub for bip49 and zprv/zpub for bip84
+ *  Public key and key identifier are calculated on first use, so a const key can be shared
+ *  between threads (for example a root deriving accounts), but it must not be modified meanwhile.
  */
 class HDPrivateKey : public PrivateKey{
 protected:
@@ -239,6 +384,20 @@ protected:
     virtual size_t from_stream(ParseStream *s);
     virtual size_t to_stream(SerializeStream *s, size_t offset = 0) const;
     uint8_t prefix[4]; // used for parsing only
+    /** \brief derives a child, parent fingerprint is calculated only if withFingerprint is set */
+    HDPrivateKey deriveChild(uint32_t index, bool hardened, bool withFingerprint) const;
+    /** \brief key identifier (hash160 of the public key), calculated lazily */
+    mutable uint8_t keyIdentifier[20];
+    /** \brief LazyState of keyIdentifier, LAZY_READY if it corresponds to the current secret */
+    mutable uint8_t keyIdentifierState;
+    /** \brief calculates keyIdentifier if it is not ready yet */
+    void computeIdentifier() const;
+    virtual void invalidatePublicKey(){ PrivateKey::invalidatePublicKey(); keyIdentifierState = LAZY_EMPTY; };
+    /** \brief copies HD fields of the other key, key identifier only if it is ready */
+    void copyFields(const HDPrivateKey& other);
+    /** \brief deriveChildren for a part of the list, proto is the HMAC with the chain code as a key */
+    void deriveChildrenRange(const SHA512 * proto, const uint8_t sec[33], const uint32_t * indexes, size_t count,
+                             HDPrivateKey * children, HDPublicKey * xpubs, bool * ok) const;
 public:
     HDPrivateKey();
     HDPrivateKey(const uint8_t secret[32], const uint8_t chain_code[32],
@@ -255,6 +414,8 @@ public:
 #if USE_ARDUINO_STRING
     HDPrivateKey(String mnemonic, String password, const Network * network = &DEFAULT_NETWORK, void (*progress_callback)(float) = NULL);
 #endif
+    HDPrivateKey(const HDPrivateKey& other);
+    HDPrivateKey &operator=(const HDPrivateKey& other);
     ~HDPrivateKey();
     virtual size_t length() const{ return 78; };
     /** \brief Length of the key in base58 encoding (111). */
@@ -291,17 +452,30 @@ public:
     std::string address() const;
 #endif
 
+    /** \brief populates array with the key identifier (hash160 of the public key) */
+    void identifier(uint8_t arr[20]) const;
     /** \brief populates array with the fingerprint of the key */
     void fingerprint(uint8_t arr[4]) const;
 
     HDPrivateKey child(uint32_t index, bool hardened = false) const;
     HDPrivateKey hardenedChild(uint32_t index) const;
+    /** \brief derives children with indexes from the list (0x80000000 + i for hardened ones)
+     *         into `children` array of `count` keys, for example accounts m/84h/0h/kh from m/84h/0h.
+     *         HMAC key, secret and fingerprint of the parent are prepared once.
+     *         Public keys are calculated only if `xpubs` is not NULL, then xpubs get `count` keys as well.
+     *         With USE_STD_THREAD the list is split between `threads` threads (0 - one per CPU core).
+     *         Returns number of derived keys, 0 on error.
+     */
+    size_t deriveChildren(const uint32_t * indexes, size_t count, HDPrivateKey * children,
+                          HDPublicKey * xpubs = NULL, unsigned int threads = 0) const;
     /** \brief derives a child according to derivation path. Use 0x80000000 + index for hardened index. */
-    HDPrivateKey derive(uint32_t * index, size_t len) const;
+    HDPrivateKey derive(const uint32_t * index, size_t len) const;
+    /** \brief derives a child according to derivation path. */
+    HDPrivateKey derive(const DerivationPath& path) const;
     /** \brief derives a child according to derivation path. For example "m/84h/1h/0h/1/23/" for the 23rd change address for testnet with P2WPKH type (bip84). */
     HDPrivateKey derive(const char * path) const;
     // just to make sure it is compressed
-    PublicKey publicKey() const{ PublicKey p = pubKey; p.compressed = true; return p; };
+    PublicKey publicKey() const{ computePublicKey(); PublicKey p = pubKey; p.compressed = true; return p; };
 };
 
 /**
@@ -311,6 +485,8 @@ public:
  *         [slip32](https://github.com/satoshilabs/slips/blob/master/slip-0032.md).
  *  You can derive children
  *  xpub method return strings according to slip32, xpub for bip44, ypub for bip49 and zpub for bip84
+ *  Key identifier is calculated on first use, so a const key can be shared
+ *  between threads (for example an account deriving addresses), but it must not be modified meanwhile.
  */
 class HDPublicKey : public PublicKey{
     size_t to_bytes(uint8_t * arr, size_t len) const;
@@ -319,6 +495,14 @@ class HDPublicKey : public PublicKey{
     virtual size_t from_stream(ParseStream *s);
     virtual size_t to_stream(SerializeStream *s, size_t offset = 0) const;
     uint8_t prefix[4]; // used for parsing only
+    /** \brief key identifier (hash160 of the public key), calculated lazily */
+    mutable uint8_t keyIdentifier[20];
+    /** \brief LazyState of keyIdentifier, LAZY_READY if it corresponds to the current point */
+    mutable uint8_t keyIdentifierState;
+    /** \brief calculates keyIdentifier if it is not ready yet */
+    void computeIdentifier() const;
+    /** \brief copies HD fields of the other key, key identifier only if it is ready */
+    void copyFields(const HDPublicKey& other);
 public:
     HDPublicKey();
     HDPublicKey(const uint8_t point[64], const uint8_t chain_code[32],
@@ -328,6 +512,8 @@ public:
                  const Network * net = &DEFAULT_NETWORK,
                  ScriptType key_type = UNKNOWN_TYPE);
     HDPublicKey(const char * xpubArr);
+    HDPublicKey(const HDPublicKey& other);
+    HDPublicKey &operator=(const HDPublicKey& other);
     ~HDPublicKey();
     /** \brief Length of the key (78). */
     virtual size_t length() const{ return 78; };
@@ -352,15 +538,24 @@ public:
     std::string address() const;
 #endif
 
+    /** \brief populates array with the key identifier (hash160 of the public key) */
+    void identifier(uint8_t arr[20]) const;
     /** \brief populates array with the fingerprint of the key */
-    void fingerprint(uint8_t arr[4]);
+    void fingerprint(uint8_t arr[4]) const;
 
     /** \brief derive a child. 
      *         You can derive only normal children (not hardened) from the public key. 
      */
     HDPublicKey child(uint32_t index) const;
+    /** \brief derives children with indexes from `start` to `end` (not including `end`)
+     *         into `children` array of `end-start` keys. Much faster than calling `child()`
+     *         in a loop. Returns number of derived keys, 0 on hardened indexes or memory error.
+     */
+    size_t deriveRange(uint32_t start, uint32_t end, HDPublicKey * children) const;
     /** \brief derives a child according to derivation path. */
-    HDPublicKey derive(uint32_t * index, size_t len) const;
+    HDPublicKey derive(const uint32_t * index, size_t len) const;
+    /** \brief derives a child according to derivation path, the path can't have hardened indexes. */
+    HDPublicKey derive(const DerivationPath& path) const;
     /** \brief derives a child according to derivation path. For example "m/1/23/" for the 23rd change address. */
     HDPublicKey derive(const char * path) const;
 };
@@ -404,6 +599,32 @@ public:
     bool operator!=(const Signature& other) const{ return !operator==(other); };
 };
 
+/**
+ *  \brief Schnorr signature (bip340). Serialized as `<R.x[32]><s[32]>`.
+ */
+class SchnorrSignature : public Streamable{
+protected:
+    uint8_t r[32];
+    uint8_t s[32];
+    virtual size_t from_stream(ParseStream *s);
+    virtual size_t to_stream(SerializeStream *s, size_t offset = 0) const;
+public:
+    SchnorrSignature(){ reset(); memset(r, 0, 32); memset(s, 0, 32); };
+    SchnorrSignature(const uint8_t r_arr[32], const uint8_t s_arr[32]){ reset(); memcpy(r, r_arr, 32); memcpy(s, s_arr, 32); };
+    SchnorrSignature(const uint8_t sig[64]){ reset(); parse(sig, 64); };
+    explicit SchnorrSignature(const char * hex){ reset(); parse(hex, strlen(hex)); };
+    virtual size_t length() const{ return 64; };
+
+    /** \brief populates array with <r[32]><s[32]> */
+    void bin(uint8_t arr[64]) const{ memcpy(arr, r, 32); memcpy(arr+32, s, 32); };
+
+    bool isValid() const{ uint8_t arr[32] = { 0 }; return !((memcmp(r, arr, 32) == 0) && (memcmp(s, arr, 32)==0)); };
+    explicit operator bool() const{ return isValid(); };
+
+    bool operator==(const SchnorrSignature& other) const{ return (memcmp(r, other.r, 32) == 0) && (memcmp(s, other.s, 32) == 0); };
+    bool operator!=(const SchnorrSignature& other) const{ return !operator==(other); };
+};
+
 /**
  *  \brief Script class. Parsing requires the length of the script in the beginning.
  */
@@ -431,7 +652,7 @@ public:
     Script(const std::string address){ fromAddress(address.c_str()); };
 #endif
     /** \brief creates one of standart scripts (P2PKH, P2WPKH) */
-    Script(const PublicKey pubkey, ScriptType type = P2PKH);
+    Script(const PublicKey &pubkey, ScriptType type = P2PKH);
     /** \brief creates one of standart scripts (P2SH, P2WSH) */
     Script(const Script &other, ScriptType type);
     Script(const Script &other); // copy
@@ -450,12 +671,17 @@ public:
 
     /** \brief length of the script with varint */
     virtual size_t length() const;    
+    /** \brief length of the script without varint */
+    size_t scriptLength() const{ return scriptLen; };
+    /** \brief copies the script without varint to the array,
+     *         returns number of bytes written, 0 if the array is too small */
+    size_t serializeScript(uint8_t * array, size_t len) const;
     /** \brief pushes a single byte (op_code) to the end */
     size_t push(uint8_t code);
     /** \brief pushes bytes from data object to the end */
     size_t push(const uint8_t * data, size_t len);
     /** \brief adds <len><sec> to the script */
-    size_t push(const PublicKey pubkey);
+    size_t push(const PublicKey &pubkey);
     /** \brief adds <len><der><sigType> to the script */
     size_t push(const Signature sig, SigHashType sigType = SIGHASH_ALL);
     /** \brief adds <len><script> to the script (used for P2SH) */
@@ -463,6 +689,8 @@ public:
 
     /** \brief returns scriptPubkey for this scripts (P2SH or P2WSH) */
     Script scriptPubkey(ScriptType type = P2SH) const;
+    /** \brief populates hash with the taproot leaf hash of the script (bip341) */
+    int tapLeafHash(uint8_t hash[32], uint8_t leafVersion = 0xC0) const;
 
     Script &operator=(const Script &other);                   // assignment
 
@@ -495,14 +723,17 @@ public:
     virtual size_t length() const;
     Witness();
     Witness(const uint8_t * buffer, size_t len);
-    Witness(const Signature sig, const PublicKey pub);
+    Witness(const Signature sig, const PublicKey &pub);
     Witness(const Witness &other); // copy
     /** \brief returns number of elements in the witness */
     uint8_t count() const{ return numElements; };
+    /** \brief copies element `index` to the array, returns its length,
+     *         0 if there is no such element or the array is too small */
+    size_t element(uint8_t index, uint8_t * data, size_t len) const;
     /** \brief adds `<len><data>` to the witness */
     size_t push(const uint8_t * data, size_t len);
     /** \brief adds `<len><sec>` to the witness */
-    size_t push(const PublicKey pubkey);
+    size_t push(const PublicKey &pubkey);
     /** \brief adds `<len><der><sigType>` to the witness */
     size_t push(const Signature sig, SigHashType sigType = SIGHASH_ALL);
     /** \brief adds `<len><script>` to the witness */
@@ -572,6 +803,19 @@ public:
     std::string address(const Network * network = &DEFAULT_NETWORK) const{ return scriptPubkey.address(network); };
 #endif
 };
+/**
+ *  \brief Transaction-wide parts of the taproot signature hash (bip341).
+ *         Fill it once with Tx::precomputeTaproot() and reuse it for every input and leaf.
+ *         Recompute it if inputs, outputs or spent outputs change.
+ */
+struct TaprootSigHashCache{
+    uint8_t shaPrevouts[32];
+    uint8_t shaAmounts[32];
+    uint8_t shaScriptPubkeys[32];
+    uint8_t shaSequences[32];
+    uint8_t shaOutputs[32];
+};
+
 /**
  *  \brief Transaction class.<br>
  *         Can be segwit or not. For legacy tx serializes as `<ver><inputsNumber><inputs><outputsNumber><outputs><locktime>`<br>
@@ -631,6 +875,19 @@ public:
     int hashOutputs(uint8_t h[32]) const;
     int sigHashSegwit(uint8_t h[32], uint8_t inputIndex, const Script scriptPubKey, uint64_t amount, SigHashType sighash = SIGHASH_ALL) const;
 
+    /** \brief computes transaction-wide hashes for sigHashTaproot.
+     *         spentOutputs are the outputs spent by the inputs, inputsNumber of them. */
+    int precomputeTaproot(TaprootSigHashCache * cache, const TxOut * spentOutputs) const;
+    /** \brief calculates a taproot (bip341) hash to sign for certain input.
+     *         sighash is one of SigHashType, optionally with SIGHASH_ANYONECANPAY flag.
+     *         For script path spending pass the leaf hash (Script::tapLeafHash) and position
+     *         of the last executed OP_CODESEPARATOR (0xFFFFFFFF if none), keep leafHash NULL for key path.
+     *         annex should start with 0x50. Returns 0 if sighash type or inputIndex is invalid.
+     */
+    int sigHashTaproot(uint8_t h[32], size_t inputIndex, const TaprootSigHashCache * cache, const TxOut * spentOutputs,
+                       uint8_t sighash = SIGHASH_DEFAULT, const uint8_t * leafHash = NULL, uint32_t codesepPos = 0xFFFFFFFF,
+                       const uint8_t * annex = NULL, size_t annexLen = 0) const;
+
 #if 0
     /** \brief sorts inputs and outputs in alphabetical order */
     void sort();
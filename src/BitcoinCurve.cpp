@@ -3,9 +3,9 @@
 #include "utility/trezor/rfc6979.h"
 #include "utility/trezor/ecdsa.h"
 #include "utility/trezor/secp256k1.h"
+#include <stdlib.h>
 
 size_t ECPoint::from_stream(ParseStream *s){
-	static uint8_t first_byte;
 	if(status == PARSING_FAILED){
 		return 0;
 	}
@@ -26,12 +26,13 @@ size_t ECPoint::from_stream(ParseStream *s){
 				bytes_parsed += bytes_read;
 				return bytes_read;
 			}
-			first_byte = c;
 			if(c == 0x04){ // uncompressed
 				bytes_to_read += 32;
 				compressed = false;
 			}else{
 				compressed = true;
+				// y is not known yet, the prefix is kept in its place
+				point[63] = c;
 			}
 		}
 	}
@@ -42,7 +43,7 @@ size_t ECPoint::from_stream(ParseStream *s){
 	if(bytes_to_read==0){
 		if(compressed){
 			uint8_t buf[33];
-			buf[0] = first_byte;
+			buf[0] = point[63];
 			memcpy(buf+1, point, 32);
             uint8_t arr[65];
             ecdsa_uncompress_pubkey(&secp256k1, buf, arr);
@@ -78,9 +79,18 @@ size_t ECPoint::to_stream(SerializeStream *s, size_t offset) const{
 	}
     return bytes_written;
 }
+// same as to_stream() but without going through the stream byte by byte
 size_t ECPoint::sec(uint8_t * arr, size_t len) const{
-	SerializeByteStream s(arr, len);
-	return ECPoint::to_stream(&s);
+	if(len == 0){
+		return 0;
+	}
+	arr[0] = compressed ? (0x02 + (point[63] & 0x01)) : 0x04;
+	size_t l = ECPoint::length() - 1;
+	if(l > len - 1){
+		l = len - 1;
+	}
+	memcpy(arr+1, point, l);
+	return l+1;
 }
 size_t ECPoint::fromSec(const uint8_t * arr, size_t len){
 	ParseByteStream s(arr, len);
@@ -110,25 +120,21 @@ bool ECPoint::isValid() const{
 	if(status != PARSING_DONE){
 		return false;
 	}
-    curve_point pub;
-	uint8_t buf[65];
-	sec(buf, 65);
-	return ecdsa_read_pubkey(&secp256k1, buf, &pub);
+	// coordinates are stored uncompressed, checking the curve equation
+	// is much cheaper than recovering y from the compressed sec
+	curve_point pub;
+	bn_read_be(point, &pub.x);
+	bn_read_be(point+32, &pub.y);
+	return ecdsa_validate_pubkey(&secp256k1, &pub);
 };
 
 ECPoint ECPoint::operator+(const ECPoint& other) const{
-	if(*this == InfinityPoint){
-		return other;
-	}
-	if(other == InfinityPoint){
-		return *this;
-	}
+	// coordinates are already validated, no need to go through sec encoding
     curve_point p1, p2;
-	uint8_t buf[65];
-	sec(buf, 65);
-	ecdsa_read_pubkey(&secp256k1, buf, &p1);
-	other.sec(buf, 65);
-	ecdsa_read_pubkey(&secp256k1, buf, &p2);
+	bn_read_be(point, &p1.x);
+	bn_read_be(point+32, &p1.y);
+	bn_read_be(other.point, &p2.x);
+	bn_read_be(other.point+32, &p2.y);
     point_add(&secp256k1,&p1,&p2);
     ECPoint sum;
 	bn_write_be(&p2.x, sum.point);
@@ -142,7 +148,7 @@ ECPoint ECPoint::operator-() const{
 	ECPoint a = *this;
 	bignum256 y;
 	bn_read_be(point+32, &y);
-	bn_inverse(&y, &secp256k1.prime);
+	bn_subtract(&secp256k1.prime, &y, &y);
 	bn_write_be(&y, a.point+32);
 	return a;
 }
@@ -151,6 +157,272 @@ ECPoint ECPoint::operator-(const ECPoint& other) const{
 	return *this+a;
 }
 
+/*********** ECJacobianPoint ***********/
+
+ECJacobianPoint::ECJacobianPoint(const ECPoint& p){
+	curve_point cp;
+	bn_read_be(p.point, &cp.x);
+	bn_read_be(p.point+32, &cp.y);
+	point_jacobian_set_affine(&cp, &jp);
+}
+ECPoint ECJacobianPoint::affine(bool use_compressed) const{
+	ECPoint p;
+	curve_point cp;
+	point_jacobian_normalize(&jp, &cp, &secp256k1.prime);
+	bn_write_be(&cp.x, p.point);
+	bn_write_be(&cp.y, p.point+32);
+	p.compressed = use_compressed;
+	return p;
+}
+bool ECJacobianPoint::isInfinity() const{
+	return point_jacobian_is_infinity(&jp, &secp256k1.prime);
+}
+bool ECJacobianPoint::operator==(const ECJacobianPoint& other) const{
+	bool inf1 = isInfinity();
+	bool inf2 = other.isInfinity();
+	if(inf1 || inf2){
+		return inf1 && inf2;
+	}
+	// x1 * z2^2 == x2 * z1^2 and y1 * z2^3 == y2 * z1^3
+	const bignum256 * prime = &secp256k1.prime;
+	bignum256 z1, z2, a, b;
+	z1 = jp.z;
+	bn_multiply(&z1, &z1, prime);
+	z2 = other.jp.z;
+	bn_multiply(&z2, &z2, prime);
+	a = jp.x;
+	bn_multiply(&z2, &a, prime);
+	b = other.jp.x;
+	bn_multiply(&z1, &b, prime);
+	bn_mod(&a, prime);
+	bn_mod(&b, prime);
+	if(!bn_is_equal(&a, &b)){
+		return false;
+	}
+	bn_multiply(&jp.z, &z1, prime);
+	bn_multiply(&other.jp.z, &z2, prime);
+	a = jp.y;
+	bn_multiply(&z2, &a, prime);
+	b = other.jp.y;
+	bn_multiply(&z1, &b, prime);
+	bn_mod(&a, prime);
+	bn_mod(&b, prime);
+	return bn_is_equal(&a, &b);
+}
+ECJacobianPoint ECJacobianPoint::operator+(const ECJacobianPoint& other) const{
+	ECJacobianPoint sum = other;
+	point_jacobian_add_jacobian(&jp, &sum.jp, &secp256k1);
+	return sum;
+}
+ECJacobianPoint ECJacobianPoint::operator-() const{
+	ECJacobianPoint a = *this;
+	point_jacobian_negate(&a.jp, &secp256k1.prime);
+	return a;
+}
+ECJacobianPoint ECJacobianPoint::operator-(const ECJacobianPoint& other) const{
+	return *this+(-other);
+}
+
+size_t batchAffine(const ECJacobianPoint * points, size_t len, ECPoint * result, bool use_compressed){
+	if(len == 0){
+		return 0;
+	}
+	const bignum256 * prime = &secp256k1.prime;
+	// z coordinates to invert and scratch space for bn_inverse_batch
+	bignum256 * zs = (bignum256 *)calloc(2*len, sizeof(bignum256));
+	if(zs == NULL){
+		return 0;
+	}
+	bignum256 * scratch = zs + len;
+	for(size_t i=0; i<len; i++){
+		if(points[i].isInfinity()){
+			bn_one(&zs[i]); // placeholder, can't invert zero
+		}else{
+			zs[i] = points[i].jp.z;
+		}
+	}
+	bn_inverse_batch(zs, len, prime, scratch);
+	for(size_t i=0; i<len; i++){
+		result[i] = InfinityPoint;
+		result[i].compressed = use_compressed;
+		if(points[i].isInfinity()){
+			continue;
+		}
+		bignum256 z2 = zs[i];
+		bignum256 x = points[i].jp.x;
+		bignum256 y = points[i].jp.y;
+		bn_multiply(&zs[i], &z2, prime); // z^-2
+		bn_multiply(&z2, &x, prime);     // x * z^-2
+		bn_multiply(&zs[i], &z2, prime); // z^-3
+		bn_multiply(&z2, &y, prime);     // y * z^-3
+		bn_mod(&x, prime);
+		bn_mod(&y, prime);
+		bn_write_be(&x, result[i].point);
+		bn_write_be(&y, result[i].point+32);
+	}
+	free(zs);
+	return len;
+}
+
+size_t multiScalarMultiply(const ECScalar * scalars, const ECPoint * points, size_t len, ECJacobianPoint * result){
+	point_jacobian_set_infinity(&result->jp);
+	if(len == 0){
+		return 0;
+	}
+	// bucket window ~ log2(len) - 2 balances additions of the points and of the buckets
+	int window = 2;
+	while(window < 16 && ((size_t)1 << (window + 3)) <= len){
+		window++;
+	}
+	size_t nbuckets = ((size_t)1 << window) - 1;
+	bignum256 * ks = (bignum256 *)calloc(len, sizeof(bignum256));
+	curve_point * ps = (curve_point *)calloc(len, sizeof(curve_point));
+	jacobian_curve_point * buckets = (jacobian_curve_point *)calloc(nbuckets, sizeof(jacobian_curve_point));
+	if(ks == NULL || ps == NULL || buckets == NULL){
+		free(ks);
+		free(ps);
+		free(buckets);
+		return 0;
+	}
+	uint8_t num[32];
+	for(size_t i=0; i<len; i++){
+		scalars[i].getSecret(num);
+		bn_read_be(num, &ks[i]);
+		// InfinityPoint is all zeros, the same as in curve_point
+		bn_read_be(points[i].point, &ps[i].x);
+		bn_read_be(points[i].point+32, &ps[i].y);
+	}
+	point_multiply_multi(&secp256k1, len, ks, ps, window, buckets, &result->jp);
+	free(ks);
+	free(ps);
+	free(buckets);
+	return len;
+}
+
+/*********** ECPointTable **************/
+
+void ECPointTable::clear(){
+	if(table != NULL){
+		memset(table, 0, 64*sizeof(*table));
+		free(table);
+		table = NULL;
+	}
+}
+bool ECPointTable::allocate(){
+	if(table == NULL){
+		table = (curve_point (*)[8])calloc(64, sizeof(*table));
+	}
+	return (table != NULL);
+}
+ECPointTable::ECPointTable(const ECPoint& p){
+	table = NULL;
+	reset();
+	build(p);
+}
+ECPointTable::ECPointTable(const ECPointTable& other){
+	table = NULL;
+	reset();
+	*this = other;
+}
+ECPointTable &ECPointTable::operator=(const ECPointTable& other){
+	if(this == &other){
+		return *this;
+	}
+	clear();
+	reset();
+	status = other.status;
+	if(other.table != NULL){
+		if(!allocate()){
+			status = PARSING_FAILED;
+			return *this;
+		}
+		memcpy(table, other.table, 64*sizeof(*table));
+	}
+	return *this;
+}
+bool ECPointTable::build(const ECPoint& p){
+	reset();
+	status = PARSING_FAILED;
+	if(!p.isValid() || !allocate()){
+		clear();
+		return false;
+	}
+	curve_point cp;
+	bn_read_be(p.point, &cp.x);
+	bn_read_be(p.point+32, &cp.y);
+	if(!point_precompute_table(&secp256k1, &cp, table)){
+		clear();
+		return false;
+	}
+	status = PARSING_DONE;
+	return true;
+}
+ECPoint ECPointTable::point() const{
+	ECPoint p;
+	if(table != NULL){
+		bn_write_be(&table[0][0].x, p.point);
+		bn_write_be(&table[0][0].y, p.point+32);
+	}
+	return p;
+}
+size_t ECPointTable::to_stream(SerializeStream *s, size_t offset) const{
+	size_t bytes_written = 0;
+	if(table == NULL){
+		return 0;
+	}
+	uint8_t arr[64];
+	while(s->available() && offset+bytes_written < length()){
+		size_t cur = offset+bytes_written;
+		if(bytes_written == 0 || cur % 64 == 0){ // next point
+			const curve_point * p = &table[cur/512][(cur/64) % 8];
+			bn_write_be(&p->x, arr);
+			bn_write_be(&p->y, arr+32);
+		}
+		s->write(arr[cur % 64]);
+		bytes_written++;
+	}
+	return bytes_written;
+}
+size_t ECPointTable::from_stream(ParseStream *s){
+	if(status == PARSING_FAILED){
+		return 0;
+	}
+	if(status == PARSING_DONE){
+		bytes_parsed = 0;
+	}
+	status = PARSING_INCOMPLETE;
+	if(!allocate()){
+		status = PARSING_FAILED;
+		return 0;
+	}
+	size_t bytes_read = 0;
+	while(s->available() && bytes_parsed+bytes_read < length()){
+		size_t cur = bytes_parsed+bytes_read;
+		buf[cur % 64] = s->read();
+		bytes_read++;
+		if(cur % 64 == 63){ // full point
+			curve_point * p = &table[cur/512][(cur/64) % 8];
+			bn_read_be(buf, &p->x);
+			bn_read_be(buf+32, &p->y);
+			if(!ecdsa_validate_pubkey(&secp256k1, p)){
+				status = PARSING_FAILED;
+				bytes_parsed += bytes_read;
+				return bytes_read;
+			}
+		}
+	}
+	if(bytes_parsed+bytes_read == length()){
+		// points on the curve are not enough, entries must be multiples of the first one
+		if(point_check_table(&secp256k1, table)){
+			status = PARSING_DONE;
+		}else{
+			status = PARSING_FAILED;
+		}
+	}
+	bytes_parsed += bytes_read;
+	return bytes_read;
+}
+
 /*********** ECScalar ******************/
 
 size_t ECScalar::from_stream(ParseStream *s){
@@ -274,4 +546,42 @@ ECPoint operator*(const ECScalar& scalar, const ECPoint& point){
 	}
 	r.compressed = point.compressed;
 	return r;
+}
+ECJacobianPoint operator*(const ECScalar& scalar, const ECJacobianPoint& point){
+	ECJacobianPoint r;
+	uint8_t num[32];
+	scalar.getSecret(num);
+	bignum256 d;
+	bn_read_be(num, &d);
+	memset(num, 0, 32);
+	curve_point p;
+	bignum256 one;
+	bn_one(&one);
+	if(bn_is_equal(&point.jp.z, &one)){ // already affine, no need to invert
+		p.x = point.jp.x;
+		p.y = point.jp.y;
+	}else{
+		point_jacobian_normalize(&point.jp, &p, &secp256k1.prime);
+	}
+	if(point_is_equal(&p, &secp256k1.G)){
+		scalar_multiply_jacobian(&secp256k1, &d, &r.jp);
+	}else if(!point_is_infinity(&p)){
+		point_multiply_jacobian(&secp256k1, &d, &p, &r.jp);
+	}
+	memset(&d, 0, sizeof(d));
+	return r;
+}
+ECJacobianPoint operator*(const ECScalar& scalar, const ECPointTable& t){
+	ECJacobianPoint r;
+	if(!t.isValid()){
+		return r;
+	}
+	uint8_t num[32];
+	scalar.getSecret(num);
+	bignum256 d;
+	bn_read_be(num, &d);
+	memset(num, 0, 32);
+	point_multiply_precomputed_jacobian(&secp256k1, t.table, &d, &r.jp);
+	memset(&d, 0, sizeof(d));
+	return r;
 }
\ No newline at end of file
@@ -3,6 +3,7 @@
 
 #include "uBitcoin_conf.h"
 #include "BaseClasses.h"
+#include "utility/trezor/ecdsa.h"
 
 class ECPoint : public Streamable{
 protected:
@@ -25,26 +26,16 @@ public:
     size_t fromSec(const uint8_t * arr, size_t len);
 #if USE_ARDUINO_STRING
     String sec() const{
-        char arr[65*2+1] = "";
-        SerializeByteStream stream(arr, sizeof(arr));
-        ECPoint::to_stream(&stream);
-        if(compressed){
-            arr[33*2+1] = 0;
-        }
-        String s(arr);
-        return s;
+        uint8_t arr[65];
+        size_t len = sec(arr, sizeof(arr));
+        return toHex(arr, len);
     };
 #endif
 #if USE_STD_STRING
     std::string sec() const{
-        char arr[65*2+1] = "";
-        SerializeByteStream stream(arr, sizeof(arr));
-        ECPoint::to_stream(&stream);
-        if(compressed){
-            arr[33*2+1] = 0;
-        }
-        std::string s(arr);
-        return s;
+        uint8_t arr[65];
+        size_t len = sec(arr, sizeof(arr));
+        return toHex(arr, len);
     };
 #endif
     // bool verify(const Signature sig, const uint8_t hash[32]) const;
@@ -63,6 +54,46 @@ public:
 const ECPoint InfinityPoint;
 const ECPoint GeneratorPoint("0279be667ef9dcbbac55a06295ce870b07029bfcdb2dce28d959f2815b16f81798");
 
+/**
+ *  \brief A point on the curve in jacobian coordinates (X/Z^2, Y/Z^3).
+ *         Additions, subtractions and multiplications stay in jacobian form
+ *         and don't require field inversions, so chains like `a + b - c + k*G`
+ *         are much cheaper than with ECPoint. Convert to ECPoint with `affine()`
+ *         only when you need coordinates or sec bytes.
+ */
+class ECJacobianPoint{
+public:
+    jacobian_curve_point jp;
+
+    ECJacobianPoint(){ point_jacobian_set_infinity(&jp); };
+    ECJacobianPoint(const ECPoint& p);
+
+    /** \brief Converts the point to affine coordinates (one field inversion) */
+    ECPoint affine(bool use_compressed = true) const;
+    /** \brief Writes sec encoding of the point to the array */
+    size_t sec(uint8_t * arr, size_t len, bool use_compressed = true) const{ return affine(use_compressed).sec(arr, len); };
+
+    bool isInfinity() const;
+    bool operator==(const ECJacobianPoint& other) const;
+    bool operator!=(const ECJacobianPoint& other) const{ return !operator==(other); };
+
+    ECJacobianPoint operator+(const ECJacobianPoint& other) const;
+    ECJacobianPoint operator-() const;
+    ECJacobianPoint operator-(const ECJacobianPoint& other) const;
+    ECJacobianPoint operator+=(const ECJacobianPoint& other){ *this = *this+other; return *this; };
+    ECJacobianPoint operator-=(const ECJacobianPoint& other){ *this = *this-other; return *this; };
+};
+
+/** \brief Converts `len` jacobian points to affine coordinates with a single
+ *         field inversion (Montgomery's trick). Much faster than calling
+ *         `affine()` on every point when you have many of them.
+ *         Returns number of converted points, 0 if memory allocation failed.
+ */
+size_t batchAffine(const ECJacobianPoint * points, size_t len, ECPoint * result, bool use_compressed = true);
+
+inline ECJacobianPoint operator+(const ECPoint& p, const ECJacobianPoint& q){ return ECJacobianPoint(p)+q; };
+inline ECJacobianPoint operator-(const ECPoint& p, const ECJacobianPoint& q){ return ECJacobianPoint(p)-q; };
+
 class ECScalar : public Streamable{
 protected:
     virtual size_t from_stream(ParseStream *s);
@@ -121,4 +152,57 @@ ECPoint operator*(const ECScalar& d, const ECPoint& p);
 inline ECPoint operator*(const ECPoint& p, const ECScalar& d){ return d*p; };
 inline ECPoint operator/(const ECPoint& p, const ECScalar& d){ return (ECScalar(1)/d)*p; };
 
+/** \brief Multiplies the point by scalar, result stays in jacobian coordinates.
+ *         If the point is GeneratorPoint precomputed table is used.
+ */
+ECJacobianPoint operator*(const ECScalar& d, const ECJacobianPoint& p);
+inline ECJacobianPoint operator*(const ECJacobianPoint& p, const ECScalar& d){ return d*p; };
+
+/** \brief Computes scalars[0]*points[0] + ... + scalars[len-1]*points[len-1]
+ *         with Pippenger's bucket method, much faster than `len` separate multiplications
+ *         when there are many points. The timing depends on the scalars, don't use it with secrets.
+ *         Returns number of processed points, 0 if memory allocation failed.
+ */
+size_t multiScalarMultiply(const ECScalar * scalars, const ECPoint * points, size_t len, ECJacobianPoint * result);
+
+/**
+ *  \brief Precomputed multiples of a point: (2j+1) * 16^i * P for i < 64, j < 8.
+ *         Building the table costs roughly as much as a few multiplications,
+ *         afterwards every multiplication by this point requires only 64 additions
+ *         and no doublings. Use it for points you multiply many times (cosigner keys,
+ *         watched xpubs). The table is Streamable, so you can serialize it and cache it
+ *         (64 bytes per entry, 32768 bytes in total). Parsed tables are checked
+ *         for consistency, tampered or corrupted data gives PARSING_FAILED.
+ *         Table is allocated on the heap, check `isValid()` after construction.
+ */
+class ECPointTable : public Streamable{
+protected:
+    virtual size_t from_stream(ParseStream *s);
+    virtual size_t to_stream(SerializeStream *s, size_t offset = 0) const;
+    curve_point (*table)[8]; // 64 rows of 8 points
+    uint8_t buf[64]; // for parsing only
+    void clear();
+    bool allocate();
+public:
+    ECPointTable(){ table = NULL; reset(); };
+    explicit ECPointTable(const ECPoint& p);
+    ECPointTable(const ECPointTable& other);
+    ~ECPointTable(){ clear(); };
+    virtual size_t length() const{ return 64*8*64; };
+
+    /** \brief Builds the table for the point. Returns false if point is invalid or out of memory */
+    bool build(const ECPoint& p);
+    /** \brief Returns the point the table was built for */
+    ECPoint point() const;
+    virtual bool isValid() const{ return (table != NULL) && (status == PARSING_DONE); };
+    explicit operator bool() const { return isValid(); };
+
+    ECPointTable &operator=(const ECPointTable& other);
+    friend ECJacobianPoint operator*(const ECScalar& d, const ECPointTable& t);
+};
+
+/** \brief Multiplies the precomputed point by scalar, result stays in jacobian coordinates */
+ECJacobianPoint operator*(const ECScalar& d, const ECPointTable& t);
+inline ECJacobianPoint operator*(const ECPointTable& t, const ECScalar& d){ return d*t; };
+
 #endif // __BITCOIN_CURVE_H__
\ No newline at end of file
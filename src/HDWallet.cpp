@@ -9,11 +9,148 @@
 #include "utility/trezor/bignum.h"
 #include "utility/trezor/ecdsa.h"
 #include "utility/trezor/secp256k1.h"
+#include "utility/trezor/pbkdf2.h"
+#include <stdlib.h>
+
+#if USE_STD_THREAD
+#include <thread>
+#include <vector>
+#endif
 
 #if USE_STD_STRING
 using std::string;
 #endif
 
+// number of children converted to affine coordinates with one inversion,
+// limits memory usage for large ranges
+#define DERIVE_RANGE_BATCH 64
+
+// ---------------------------------------------------------------- DerivationPath class
+
+DerivationPath::DerivationPath(const uint32_t * indexes, size_t len){
+    memset(index, 0, sizeof(index));
+    depth = 0;
+    valid = (len <= DERIVATION_PATH_MAX_DEPTH);
+    if(!valid){
+        return;
+    }
+    memcpy(index, indexes, len*sizeof(uint32_t));
+    depth = len;
+}
+size_t DerivationPath::from_str(const char * buf, size_t len){
+    depth = 0;
+    valid = false;
+    size_t cur = 0;
+    if(len == 0){
+        return 0;
+    }
+    if(buf[0] == 'm'){
+        cur++;
+        if(cur < len && buf[cur] != '/'){
+            return 0;
+        }
+        cur++;
+    }
+    uint8_t n = 0;
+    while(cur < len){
+        if(n >= DERIVATION_PATH_MAX_DEPTH){
+            return 0;
+        }
+        // decimal index, at least one digit, less than 2^31
+        uint32_t val = 0;
+        size_t start = cur;
+        while(cur < len && buf[cur] >= '0' && buf[cur] <= '9'){
+            if(val > (0x7FFFFFFF - (uint32_t)(buf[cur] - '0')) / 10){
+                return 0;
+            }
+            val = val*10 + (buf[cur] - '0');
+            cur++;
+        }
+        if(cur == start){
+            return 0;
+        }
+        if(cur < len && (buf[cur] == 'h' || buf[cur] == 'H' || buf[cur] == '\'')){
+            val += 0x80000000;
+            cur++;
+        }
+        index[n] = val;
+        n++;
+        if(cur < len){ // only separator can go after the index
+            if(buf[cur] != '/'){
+                return 0;
+            }
+            cur++;
+        }
+    }
+    depth = n;
+    valid = true;
+    return len;
+}
+// writes decimal representation of the index without hardened bit, returns number of digits
+static size_t indexToStr(uint32_t val, char * buf){
+    char tmp[10];
+    size_t l = 0;
+    val &= 0x7FFFFFFF;
+    do{
+        tmp[l++] = '0' + (val % 10);
+        val /= 10;
+    }while(val > 0);
+    for(size_t i=0; i<l; i++){
+        buf[i] = tmp[l-1-i];
+    }
+    return l;
+}
+size_t DerivationPath::stringLength() const{
+    size_t l = 1; // m
+    char tmp[10];
+    for(size_t i=0; i<depth; i++){
+        l += 1 + indexToStr(index[i], tmp) + (index[i] >= 0x80000000);
+    }
+    return l;
+}
+size_t DerivationPath::to_str(char * buf, size_t len) const{
+    size_t l = stringLength();
+    if(!valid || len < l+1){
+        return 0;
+    }
+    char * cur = buf;
+    *cur++ = 'm';
+    for(size_t i=0; i<depth; i++){
+        *cur++ = '/';
+        cur += indexToStr(index[i], cur);
+        if(index[i] >= 0x80000000){
+            *cur++ = 'h';
+        }
+    }
+    *cur = 0;
+    return l;
+}
+bool DerivationPath::isHardened() const{
+    for(size_t i=0; i<depth; i++){
+        if(index[i] >= 0x80000000){
+            return true;
+        }
+    }
+    return false;
+}
+bool DerivationPath::push(uint32_t childIndex){
+    if(!valid || depth >= DERIVATION_PATH_MAX_DEPTH){
+        return false;
+    }
+    index[depth] = childIndex;
+    depth++;
+    return true;
+}
+bool DerivationPath::startsWith(const DerivationPath& prefix) const{
+    if(!valid || !prefix.valid || prefix.depth > depth){
+        return false;
+    }
+    return memcmp(index, prefix.index, prefix.depth*sizeof(uint32_t)) == 0;
+}
+bool DerivationPath::operator==(const DerivationPath& other) const{
+    return valid && other.valid && depth == other.depth && startsWith(other);
+}
+
 // ---------------------------------------------------------------- HDPrivateKey class
 
 void HDPrivateKey::init(){
@@ -25,6 +162,9 @@ void HDPrivateKey::init(){
     type = UNKNOWN_TYPE;
     status = PARSING_DONE;
     pubKey.compressed = true;
+    memset(prefix, 0, sizeof(prefix));
+    memset(keyIdentifier, 0, sizeof(keyIdentifier));
+    keyIdentifierState = LAZY_EMPTY;
 }
 HDPrivateKey::HDPrivateKey(void):PrivateKey(){
     init();
@@ -47,6 +187,33 @@ HDPrivateKey::HDPrivateKey(const uint8_t secret[32],
         memset(parentFingerprint, 0, 4);
     }
 }
+HDPrivateKey::HDPrivateKey(const HDPrivateKey& other):PrivateKey(other){
+    copyFields(other);
+}
+HDPrivateKey &HDPrivateKey::operator=(const HDPrivateKey& other){
+    if(this == &other){
+        return *this;
+    }
+    PrivateKey::operator=(other);
+    copyFields(other);
+    return *this;
+}
+void HDPrivateKey::copyFields(const HDPrivateKey& other){
+    memcpy(prefix, other.prefix, sizeof(prefix));
+    memcpy(chainCode, other.chainCode, 32);
+    depth = other.depth;
+    memcpy(parentFingerprint, other.parentFingerprint, 4);
+    childNumber = other.childNumber;
+    type = other.type;
+    // other may be computing its identifier in another thread right now
+    if(lazyReady(&other.keyIdentifierState)){
+        memcpy(keyIdentifier, other.keyIdentifier, 20);
+        keyIdentifierState = LAZY_READY;
+    }else{
+        memset(keyIdentifier, 0, 20);
+        keyIdentifierState = LAZY_EMPTY;
+    }
+}
 HDPrivateKey::HDPrivateKey(const char * xprvArr){
     init();
     from_str(xprvArr, strlen(xprvArr));
@@ -190,7 +357,7 @@ size_t HDPrivateKey::from_stream(ParseStream *s){
         bn_read_be(num, &n);
         bn_mod(&n, &secp256k1.order);
         bn_write_be(&n, num);
-        pubKey = *this * GeneratorPoint;
+        invalidatePublicKey();
         pubKey.compressed = true;
     }
     bytes_parsed += bytes_read;
@@ -219,7 +386,7 @@ int HDPrivateKey::fromSeed(const uint8_t * seed, size_t seedSize, const Network
     memcpy(num, raw, 32);
     network = net;
     memcpy(chainCode, raw+32, 32);
-    pubKey = *this * GeneratorPoint;
+    invalidatePublicKey();
     pubKey.compressed = true;
     return 1;
 }
@@ -233,9 +400,12 @@ int HDPrivateKey::fromMnemonic(const char * mnemonic, size_t mnemonicSize, const
     char salt[] = "mnemonic";
     uint8_t u[64] = { 0 };
 
+    // HMAC with the mnemonic as a key, key pads are hashed only once
+    // and the context is copied for every round
+    SHA512 keyed;
+    keyed.beginHMAC((uint8_t *)mnemonic, mnemonicSize);
     // first round
-    SHA512 sha;
-    sha.beginHMAC((uint8_t *)mnemonic, mnemonicSize);
+    SHA512 sha = keyed;
     sha.write((uint8_t *)salt, strlen(salt));
     sha.write((uint8_t *)password, passwordSize);
     sha.write(ind, sizeof(ind));
@@ -246,7 +416,7 @@ int HDPrivateKey::fromMnemonic(const char * mnemonic, size_t mnemonicSize, const
         if(progress_callback != NULL && (i & 0xFF) == 0xFF){
             progress_callback((float)i/(float)(PBKDF2_ROUNDS-1));
         }
-        sha.beginHMAC((uint8_t *)mnemonic, mnemonicSize);
+        sha = keyed;
         sha.write(u, sizeof(u));
         sha.endHMAC(u);
         for(size_t j=0; j<sizeof(seed); j++){
@@ -256,6 +426,80 @@ int HDPrivateKey::fromMnemonic(const char * mnemonic, size_t mnemonicSize, const
     fromSeed(seed, sizeof(seed), net);
     return 1;
 }
+// bip39 seeds for a range of mnemonics, in chunks of 8 to fill SIMD lanes
+// ok is set to false and seeds are zeroed if memory for a salt can't be allocated
+static void mnemonicToSeedsRange(const char * const * mnemonics, const char * const * passwords, size_t count, uint8_t * seeds, bool * ok){
+    static const char prefix[] = "mnemonic";
+    PBKDF2_HMAC_SHA512_CTX pctx[8];
+    *ok = true;
+    while(count > 0 && *ok){
+        size_t n = (count > 8) ? 8 : count;
+        for(size_t i=0; i<n; i++){
+            const char * password = (passwords == NULL) ? "" : passwords[i];
+            size_t passwordLen = strlen(password);
+            uint8_t * salt = (uint8_t *)calloc(strlen(prefix) + passwordLen, sizeof(uint8_t));
+            if(salt == NULL){
+                *ok = false;
+                break;
+            }
+            memcpy(salt, prefix, strlen(prefix));
+            memcpy(salt+strlen(prefix), password, passwordLen);
+            pbkdf2_hmac_sha512_Init(&pctx[i], (const uint8_t *)mnemonics[i], strlen(mnemonics[i]), salt, strlen(prefix) + passwordLen, 1);
+            memset(salt, 0, strlen(prefix) + passwordLen);
+            free(salt);
+        }
+        if(!*ok){
+            break;
+        }
+        pbkdf2_hmac_sha512_Update_many(pctx, n, PBKDF2_ROUNDS);
+        for(size_t i=0; i<n; i++){
+            pbkdf2_hmac_sha512_Final(&pctx[i], seeds+64*i);
+        }
+        mnemonics += n;
+        if(passwords != NULL){
+            passwords += n;
+        }
+        seeds += 64*n;
+        count -= n;
+    }
+    if(!*ok){
+        memset(seeds, 0, 64*count);
+    }
+    // lanes hold HMAC states keyed with the mnemonics
+    memset(pctx, 0, sizeof(pctx));
+}
+size_t mnemonicToSeeds(const char * const * mnemonics, const char * const * passwords, size_t count, uint8_t * seeds, unsigned int threads){
+    bool ok = true;
+#if USE_STD_THREAD
+    if(threads == 0){
+        threads = std::thread::hardware_concurrency();
+    }
+    size_t perThread = (threads > 0) ? (count + threads - 1) / threads : count;
+    perThread = (perThread + 7) / 8 * 8; // keep lanes full
+    if(perThread < count){
+        std::vector<std::thread> pool;
+        size_t parts = (count + perThread - 1) / perThread;
+        bool * results = new bool[parts];
+        for(size_t p = 0; p < parts; p++){
+            size_t start = p * perThread;
+            size_t n = (count - start < perThread) ? count - start : perThread;
+            pool.push_back(std::thread(mnemonicToSeedsRange, mnemonics + start,
+                                       (passwords == NULL) ? NULL : passwords + start,
+                                       n, seeds + 64*start, &results[p]));
+        }
+        for(size_t p = 0; p < parts; p++){
+            pool[p].join();
+            ok = ok && results[p];
+        }
+        delete[] results;
+        return ok ? count : 0;
+    }
+#else
+    (void)threads;
+#endif
+    mnemonicToSeedsRange(mnemonics, passwords, count, seeds, &ok);
+    return ok ? count : 0;
+}
 #if USE_STD_STRING
 int HDPrivateKey::fromMnemonic(std::string mnemonic, std::string password, const Network * net, void (*progress_callback)(float)){
     return fromMnemonic(mnemonic.c_str(), mnemonic.length(), password.c_str(), password.length(), net, progress_callback);
@@ -340,61 +584,86 @@ int HDPrivateKey::xpub(char * arr, size_t len) const{
     return toBase58Check(hex, 45+secLen, arr, len);
 }
 
+void HDPrivateKey::computeIdentifier() const{
+    if(!lazyStart(&keyIdentifierState)){
+        return;
+    }
+    computePublicKey();
+    uint8_t secArr[33];
+    secArr[0] = 0x02 + (pubKey.point[63] & 0x01);
+    memcpy(secArr+1, pubKey.point, 32);
+    hash160_33(secArr, keyIdentifier);
+    lazyFinish(&keyIdentifierState);
+}
+void HDPrivateKey::identifier(uint8_t arr[20]) const{
+    computeIdentifier();
+    memcpy(arr, keyIdentifier, 20);
+}
 void HDPrivateKey::fingerprint(uint8_t arr[4]) const{
-    uint8_t secArr[65] = { 0 };
-    int l = publicKey().sec(secArr, sizeof(secArr));
-    uint8_t hash[20] = { 0 };
-    hash160(secArr, l, hash);
-    memcpy(arr, hash, 4);
+    computeIdentifier();
+    memcpy(arr, keyIdentifier, 4);
 }
 
 HDPublicKey HDPrivateKey::xpub() const{
     PublicKey p = publicKey();
     return HDPublicKey(p.point, chainCode, depth, parentFingerprint, childNumber, network, type);
 }
+// script type and network of a child are taken from bip44/49/84 paths: m/purpose'/coin'
+static void childTypeAndNetwork(const HDPrivateKey &parent, uint32_t index, ScriptType * type, const Network ** network){
+    *type = parent.type;
+    *network = parent.network;
+    if(index < 0x80000000){
+        return;
+    }
+    if(parent.depth == 0){
+        switch(index){
+            case 0x80000000+44:
+                *type = P2PKH;
+                break;
+            case 0x80000000+49:
+                *type = P2SH_P2WPKH;
+                break;
+            case 0x80000000+84:
+                *type = P2WPKH;
+                break;
+        }
+    }
+    if(parent.depth == 1 && parent.type != UNKNOWN_TYPE){
+        if(index == 0x80000001){
+            *network = &Testnet;
+        }
+        if(index == 0x80000000){
+            *network = &Mainnet;
+        }
+    }
+}
 HDPrivateKey HDPrivateKey::child(uint32_t index, bool hardened) const{
+    return deriveChild(index, hardened, true);
+}
+HDPrivateKey HDPrivateKey::deriveChild(uint32_t index, bool hardened, bool withFingerprint) const{
     if(index >= 0x80000000){
         hardened = true;
     }
     HDPrivateKey child;
 
-    uint8_t sec[65] = { 0 };
-    PublicKey p = publicKey();
-    int l = p.sec(sec, sizeof(sec));
-    uint8_t hash[20] = { 0 };
-    hash160(sec, l, hash);
-    memcpy(child.parentFingerprint, hash, 4);
+    // public key is required only for normal derivation and for the fingerprint
+    uint8_t sec[33] = { 0 };
+    if(!hardened){
+        computePublicKey();
+        sec[0] = 0x02 + (pubKey.point[63] & 0x01);
+        memcpy(sec+1, pubKey.point, 32);
+    }
+    if(withFingerprint){
+        computeIdentifier();
+        memcpy(child.parentFingerprint, keyIdentifier, 4);
+    }
     if(hardened && index < 0x80000000){
         index += 0x80000000;
     }
     child.childNumber = index;
     child.depth = depth+1;
 
-    child.type = type;
-    child.network = network;
-    if(hardened){
-        if(depth == 0){
-            switch(index){
-                case 0x80000000+44:
-                    child.type = P2PKH;
-                    break;
-                case 0x80000000+49:
-                    child.type = P2SH_P2WPKH;
-                    break;
-                case 0x80000000+84:
-                    child.type = P2WPKH;
-                    break;
-            }
-        }
-        if(depth == 1 && type != UNKNOWN_TYPE){
-            if(index == 0x80000001){
-                child.network = &Testnet;
-            }
-            if(index == 0x80000000){
-                child.network = &Mainnet;
-            }
-        }
-    }
+    childTypeAndNetwork(*this, index, &child.type, &child.network);
 
     uint8_t data[37];
     if(hardened){
@@ -425,57 +694,259 @@ HDPrivateKey HDPrivateKey::child(uint32_t index, bool hardened) const{
 HDPrivateKey HDPrivateKey::hardenedChild(uint32_t index) const{
     return child(index, true);
 }
+void HDPrivateKey::deriveChildrenRange(const SHA512 * proto, const uint8_t sec[33], const uint32_t * indexes, size_t count,
+                                       HDPrivateKey * children, HDPublicKey * xpubs, bool * ok) const{
+    uint8_t data[37];
+    uint8_t raw[64];
+    uint8_t secret[32];
+    size_t batch = (count < DERIVE_RANGE_BATCH) ? count : DERIVE_RANGE_BATCH;
+    ECJacobianPoint * jpoints = NULL;
+    ECPoint * points = NULL;
+    if(xpubs != NULL){
+        jpoints = new ECJacobianPoint[batch];
+        points = new ECPoint[batch];
+        if(jpoints == NULL || points == NULL){
+            delete[] jpoints;
+            delete[] points;
+            *ok = false;
+            return;
+        }
+    }
+    *ok = true;
+    for(size_t offset = 0; offset < count; offset += batch){
+        size_t n = (count - offset < batch) ? (count - offset) : batch;
+        for(size_t i = 0; i < n; i++){
+            HDPrivateKey * child = &children[offset+i];
+            uint32_t index = indexes[offset+i];
+            if(index >= 0x80000000){
+                data[0] = 0;
+                getSecret(data+1);
+            }else{
+                memcpy(data, sec, 33);
+            }
+            intToBigEndian(index, data+33, 4);
+            SHA512 sha = *proto;
+            sha.write(data, 37);
+            sha.endHMAC(raw);
 
-HDPrivateKey HDPrivateKey::derive(uint32_t * index, size_t len) const{
-    HDPrivateKey pk = *this;
-    for(size_t i=0; i<len; i++){
-        pk = pk.child(index[i]);
+            ECScalar r(raw, 32);
+            r += *this;
+            r.getSecret(secret);
+            child->setSecret(secret);
+            memcpy(child->chainCode, raw+32, 32);
+            memcpy(child->parentFingerprint, keyIdentifier, 4);
+            child->childNumber = index;
+            child->depth = depth+1;
+            childTypeAndNetwork(*this, index, &child->type, &child->network);
+            if(xpubs != NULL){
+                bignum256 k;
+                bn_read_be(secret, &k);
+                scalar_multiply_jacobian(&secp256k1, &k, &jpoints[i].jp);
+                memset(&k, 0, sizeof(k));
+            }
+        }
+        if(xpubs == NULL){
+            continue;
+        }
+        if(batchAffine(jpoints, n, points) != n){
+            *ok = false;
+            break;
+        }
+        for(size_t i = 0; i < n; i++){
+            HDPrivateKey * child = &children[offset+i];
+            // public key is known now, so the child doesn't need to compute it again
+            memcpy(child->pubKey.point, points[i].point, 64);
+            child->pubKey.invalidateHash();
+            child->pubKeyState = LAZY_READY;
+            xpubs[offset+i] = HDPublicKey(points[i].point, child->chainCode, child->depth,
+                                          child->parentFingerprint, child->childNumber,
+                                          child->network, child->type);
+        }
     }
-    return pk;
+    memset(data, 0, sizeof(data));
+    memset(raw, 0, sizeof(raw));
+    memset(secret, 0, sizeof(secret));
+    delete[] jpoints;
+    delete[] points;
 }
-HDPrivateKey HDPrivateKey::derive(const char * path) const{
-    static const char VALID_CHARS[] = "0123456789/'h";
-    size_t len = strlen(path);
-    const char * cur = path;
-    if(path[0] == 'm'){ // remove leading "m/"
-        cur+=2;
-        len-=2;
-    }
-    if(cur[len-1] == '/'){ // remove trailing "/"
-        len--;
-    }
-    HDPrivateKey pk;
-    size_t derivationLen = 1;
-    // checking if all chars are valid and counting derivation length
-    for(size_t i=0; i<len; i++){
-        const char * pch = strchr(VALID_CHARS, cur[i]);
-        if(pch == NULL){ // wrong character
-            return pk;
-        }
-        if(cur[i] == '/'){
-            derivationLen++;
-        }
-    }
-    uint32_t * derivation = (uint32_t *)calloc(derivationLen, sizeof(uint32_t));
-    size_t current = 0;
-    for(size_t i=0; i<len; i++){
-        if(cur[i] == '/'){ // next
-            current++;
+size_t HDPrivateKey::deriveChildren(const uint32_t * indexes, size_t count, HDPrivateKey * children,
+                                    HDPublicKey * xpubs, unsigned int threads) const{
+    if(count == 0 || !isValid()){
+        return 0;
+    }
+    // everything that depends only on the parent is computed once
+    uint8_t sec[33];
+    computeIdentifier();
+    sec[0] = 0x02 + (pubKey.point[63] & 0x01);
+    memcpy(sec+1, pubKey.point, 32);
+    SHA512 proto;
+    proto.beginHMAC(chainCode, sizeof(chainCode));
+    bool ok = true;
+#if USE_STD_THREAD
+    if(threads == 0){
+        threads = std::thread::hardware_concurrency();
+    }
+    size_t perThread = (threads > 0) ? (count + threads - 1) / threads : count;
+    if(perThread < DERIVE_RANGE_BATCH){
+        perThread = DERIVE_RANGE_BATCH;
+    }
+    if(perThread < count){
+        std::vector<std::thread> pool;
+        size_t parts = (count + perThread - 1) / perThread;
+        bool * results = new bool[parts];
+        for(size_t p = 0; p < parts; p++){
+            size_t start = p * perThread;
+            size_t n = (count - start < perThread) ? count - start : perThread;
+            pool.push_back(std::thread(&HDPrivateKey::deriveChildrenRange, this, &proto, sec,
+                                       indexes + start, n, children + start,
+                                       (xpubs == NULL) ? NULL : xpubs + start, &results[p]));
+        }
+        for(size_t p = 0; p < parts; p++){
+            pool[p].join();
+            ok = ok && results[p];
+        }
+        delete[] results;
+        return ok ? count : 0;
+    }
+#else
+    (void)threads;
+#endif
+    deriveChildrenRange(&proto, sec, indexes, count, children, xpubs, &ok);
+    return ok ? count : 0;
+}
+
+#if USE_BIP32_CACHE
+// LRU cache of intermediate nodes. An entry is keyed by the node
+// the derivation started from and the derivation path to the cached node.
+struct DerivationCacheEntry{
+    uint8_t base[32]; // sha256 of chain code, key, depth, type and network of the starting node
+    uint32_t path[BIP32_CACHE_MAXDEPTH];
+    uint8_t len;      // 0 for empty entries
+    uint32_t lastUsed;
+};
+static DerivationCacheEntry privateCacheEntries[BIP32_CACHE_SIZE];
+static HDPrivateKey privateCacheNodes[BIP32_CACHE_SIZE];
+static DerivationCacheEntry publicCacheEntries[BIP32_CACHE_SIZE];
+static HDPublicKey publicCacheNodes[BIP32_CACHE_SIZE];
+static uint32_t cacheCounter = 0;
+// the cache is shared by all threads, with or without USE_STD_THREAD,
+// so it is always guarded by a spinlock held for the scope of the object
+static char cacheLockFlag = 0;
+struct CacheLock{
+    CacheLock(){ while(__atomic_test_and_set(&cacheLockFlag, __ATOMIC_ACQUIRE)){} };
+    ~CacheLock(){ __atomic_clear(&cacheLockFlag, __ATOMIC_RELEASE); };
+};
+
+// returns index of the entry with the longest prefix of the path (at most len), -1 if not found
+static int cacheFind(DerivationCacheEntry * cache, const uint8_t base[32], const uint32_t * path, size_t len){
+    int found = -1;
+    for(int i=0; i<BIP32_CACHE_SIZE; i++){
+        if(cache[i].len == 0 || cache[i].len > len){
+            continue;
+        }
+        if(found >= 0 && cache[i].len <= cache[found].len){
             continue;
         }
-        const char * pch = strchr(VALID_CHARS, cur[i]);
-        uint32_t val = pch-VALID_CHARS;
-        if(derivation[current] >= 0x80000000){ // can't have anything after hardened
-            free(derivation);
-            return pk;
+        if(memcmp(cache[i].base, base, 32) == 0 && memcmp(cache[i].path, path, cache[i].len*sizeof(uint32_t)) == 0){
+            found = i;
+        }
+    }
+    if(found >= 0){
+        cache[found].lastUsed = ++cacheCounter;
+    }
+    return found;
+}
+// returns index of the entry to store the node to: the same path, an empty or the least recently used entry.
+// evicted is set if the entry had a different node
+static int cacheSlot(DerivationCacheEntry * cache, const uint8_t base[32], const uint32_t * path, size_t len, bool * evicted){
+    int slot = 0;
+    for(int i=0; i<BIP32_CACHE_SIZE; i++){
+        if(cache[i].len == len && memcmp(cache[i].base, base, 32) == 0 && memcmp(cache[i].path, path, len*sizeof(uint32_t)) == 0){
+            slot = i;
+            break;
+        }
+        if(cache[i].len == 0){
+            slot = i;
+        }else if(cache[slot].len != 0 && cache[i].lastUsed < cache[slot].lastUsed){
+            slot = i;
+        }
+    }
+    *evicted = (cache[slot].len != 0 && (cache[slot].len != len ||
+                memcmp(cache[slot].base, base, 32) != 0 || memcmp(cache[slot].path, path, len*sizeof(uint32_t)) != 0));
+    memset(&cache[slot], 0, sizeof(DerivationCacheEntry));
+    memcpy(cache[slot].base, base, 32);
+    memcpy(cache[slot].path, path, len*sizeof(uint32_t));
+    cache[slot].len = len;
+    cache[slot].lastUsed = ++cacheCounter;
+    return slot;
+}
+#endif
+
+void clearDerivationCache(){
+#if USE_BIP32_CACHE
+    CacheLock lock;
+    for(int i=0; i<BIP32_CACHE_SIZE; i++){
+        memset(&privateCacheEntries[i], 0, sizeof(DerivationCacheEntry));
+        memset(&publicCacheEntries[i], 0, sizeof(DerivationCacheEntry));
+        privateCacheNodes[i] = HDPrivateKey();
+        publicCacheNodes[i] = HDPublicKey();
+    }
+#endif
+}
+
+HDPrivateKey HDPrivateKey::derive(const uint32_t * index, size_t len) const{
+    HDPrivateKey pk = *this;
+    size_t start = 0;
+#if USE_BIP32_CACHE
+    // parent of the last child is cached, the last step always runs
+    // as it requires the parent fingerprint
+    bool useCache = (len > 1 && len-1 <= BIP32_CACHE_MAXDEPTH);
+    uint8_t base[32];
+    if(useCache){
+        SHA256 h;
+        h.write(chainCode, 32);
+        h.write(num, 32);
+        h.write(depth);
+        h.write((uint8_t)type);
+        h.write(network->xprv, 4);
+        h.end(base);
+        CacheLock lock;
+        int i = cacheFind(privateCacheEntries, base, index, len-1);
+        if(i >= 0){
+            pk = privateCacheNodes[i];
+            start = privateCacheEntries[i].len;
         }
-        if(val < 10){
-            derivation[current] = derivation[current]*10 + val;
-        }else{ // h or ' -> hardened
-            derivation[current] += 0x80000000;
+    }
+#endif
+    for(size_t i=start; i<len; i++){
+        // only the last child needs parent fingerprint
+        pk = pk.deriveChild(index[i], false, (i == len-1));
+#if USE_BIP32_CACHE
+        if(useCache && i == len-2){
+            pk.computeIdentifier(); // parent fingerprint of every child
+            CacheLock lock;
+            bool evicted;
+            int slot = cacheSlot(privateCacheEntries, base, index, len-1, &evicted);
+            if(evicted){
+                privateCacheNodes[slot] = HDPrivateKey(); // wipe the node of another wallet or account
+            }
+            privateCacheNodes[slot] = pk;
         }
+#endif
+    }
+#if USE_BIP32_CACHE
+    memset(base, 0, sizeof(base));
+#endif
+    return pk;
+}
+HDPrivateKey HDPrivateKey::derive(const DerivationPath& path) const{
+    if(!path.isValid()){
+        return HDPrivateKey();
     }
-    return derive(derivation, derivationLen);
+    return derive(path.index, path.depth);
+}
+HDPrivateKey HDPrivateKey::derive(const char * path) const{
+    return derive(DerivationPath(path));
 }
 // ---------------------------------------------------------------- HDPublicKey class
 
@@ -588,6 +1059,8 @@ size_t HDPublicKey::from_stream(ParseStream *s){
         uint8_t buf[65];
         ecdsa_uncompress_pubkey(&secp256k1, arr, buf);
         memcpy(point, buf+1, 64);
+        invalidateHash();
+        keyIdentifierState = LAZY_EMPTY;
         if(!isValid()){
             status = PARSING_FAILED;
         }
@@ -614,6 +1087,9 @@ HDPublicKey::HDPublicKey():PublicKey(){
     childNumber = 0;
     network = &DEFAULT_NETWORK;
     type = UNKNOWN_TYPE;
+    memset(prefix, 0, sizeof(prefix));
+    memset(keyIdentifier, 0, sizeof(keyIdentifier));
+    keyIdentifierState = LAZY_EMPTY;
 }
 HDPublicKey::HDPublicKey(const uint8_t p[64],
                            const uint8_t chain_code[32],
@@ -625,6 +1101,9 @@ HDPublicKey::HDPublicKey(const uint8_t p[64],
     reset();
     memcpy(point, p, 64);
     compressed = true;
+    memset(prefix, 0, sizeof(prefix));
+    memset(keyIdentifier, 0, sizeof(keyIdentifier));
+    keyIdentifierState = LAZY_EMPTY;
     type = key_type;
     network = net;
     memcpy(chainCode, chain_code, 32);
@@ -638,9 +1117,40 @@ HDPublicKey::HDPublicKey(const uint8_t p[64],
 }
 HDPublicKey::HDPublicKey(const char * xpubArr){
     reset();
+    memset(prefix, 0, sizeof(prefix));
+    memset(keyIdentifier, 0, sizeof(keyIdentifier));
+    keyIdentifierState = LAZY_EMPTY;
     network = &DEFAULT_NETWORK;
     from_str(xpubArr, strlen(xpubArr));
 }
+HDPublicKey::HDPublicKey(const HDPublicKey& other):PublicKey(static_cast<const PublicKey &>(other)){
+    copyFields(other);
+}
+HDPublicKey &HDPublicKey::operator=(const HDPublicKey& other){
+    if(this == &other){
+        return *this;
+    }
+    PublicKey::operator=(other);
+    copyFields(other);
+    return *this;
+}
+void HDPublicKey::copyFields(const HDPublicKey& other){
+    memcpy(prefix, other.prefix, sizeof(prefix));
+    memcpy(chainCode, other.chainCode, 32);
+    depth = other.depth;
+    memcpy(parentFingerprint, other.parentFingerprint, 4);
+    childNumber = other.childNumber;
+    type = other.type;
+    network = other.network;
+    // other may be computing its identifier in another thread right now
+    if(lazyReady(&other.keyIdentifierState)){
+        memcpy(keyIdentifier, other.keyIdentifier, 20);
+        keyIdentifierState = LAZY_READY;
+    }else{
+        memset(keyIdentifier, 0, 20);
+        keyIdentifierState = LAZY_EMPTY;
+    }
+}
 HDPublicKey::~HDPublicKey(void) {
     memset(point, 0, 64);
     memset(chainCode, 0, 32);
@@ -695,22 +1205,33 @@ string HDPublicKey::address() const{
 }
 #endif
 
-void HDPublicKey::fingerprint(uint8_t arr[4]){
-    uint8_t secArr[65] = { 0 };
-    int l = sec(secArr, sizeof(secArr));
-    uint8_t hash[20] = { 0 };
-    hash160(secArr, l, hash);
-    memcpy(arr, hash, 4);
+void HDPublicKey::computeIdentifier() const{
+    if(!lazyStart(&keyIdentifierState)){
+        return;
+    }
+    uint8_t secArr[33];
+    secArr[0] = 0x02 + (point[63] & 0x01);
+    memcpy(secArr+1, point, 32);
+    hash160_33(secArr, keyIdentifier);
+    lazyFinish(&keyIdentifierState);
+}
+void HDPublicKey::identifier(uint8_t arr[20]) const{
+    computeIdentifier();
+    memcpy(arr, keyIdentifier, 20);
+}
+void HDPublicKey::fingerprint(uint8_t arr[4]) const{
+    computeIdentifier();
+    memcpy(arr, keyIdentifier, 4);
 }
 
 HDPublicKey HDPublicKey::child(uint32_t index) const{
     HDPublicKey child;
 
-    uint8_t secArr[65] = { 0 };
-    int l = sec(secArr, sizeof(secArr));
-    uint8_t hash[20] = { 0 };
-    hash160(secArr, l, hash);
-    memcpy(child.parentFingerprint, hash, 4);
+    uint8_t secArr[33];
+    secArr[0] = 0x02 + (point[63] & 0x01);
+    memcpy(secArr+1, point, 32);
+    computeIdentifier();
+    memcpy(child.parentFingerprint, keyIdentifier, 4);
     child.childNumber = index;
     child.depth = depth+1;
 
@@ -736,51 +1257,120 @@ HDPublicKey HDPublicKey::child(uint32_t index) const{
     child.compressed = true;
     return child;
 }
-HDPublicKey HDPublicKey::derive(uint32_t * index, size_t len) const{
+size_t HDPublicKey::deriveRange(uint32_t start, uint32_t end, HDPublicKey * children) const{
+    if(end <= start || end > 0x80000000){
+        return 0;
+    }
+    size_t count = end - start;
+    size_t batch = (count < DERIVE_RANGE_BATCH) ? count : DERIVE_RANGE_BATCH;
+    ECJacobianPoint * jpoints = new ECJacobianPoint[batch];
+    ECPoint * points = new ECPoint[batch];
+    if(jpoints == NULL || points == NULL){
+        delete[] jpoints;
+        delete[] points;
+        return 0;
+    }
+
+    // everything that depends only on the parent is computed once
+    uint8_t secArr[33];
+    secArr[0] = 0x02 + (point[63] & 0x01);
+    memcpy(secArr+1, point, 32);
+    computeIdentifier();
+    curve_point parent;
+    bn_read_be(point, &parent.x);
+    bn_read_be(point+32, &parent.y);
+    SHA512 proto;
+    proto.beginHMAC(chainCode, sizeof(chainCode));
+    proto.write(secArr, 33);
+
+    for(size_t offset = 0; offset < count; offset += batch){
+        size_t n = (count - offset < batch) ? (count - offset) : batch;
+        for(size_t i = 0; i < n; i++){
+            HDPublicKey * child = &children[offset+i];
+            uint32_t index = start + offset + i;
+            memcpy(child->parentFingerprint, keyIdentifier, 4);
+            child->childNumber = index;
+            child->depth = depth+1;
+            child->type = type;
+            child->network = network;
+
+            uint8_t arr[4];
+            intToBigEndian(index, arr, 4);
+            uint8_t raw[64];
+            SHA512 sha = proto;
+            sha.write(arr, 4);
+            sha.endHMAC(raw);
+            memcpy(child->chainCode, raw+32, 32);
+
+            // r*G + parent, stays in jacobian coordinates
+            bignum256 r;
+            bn_read_be(raw, &r);
+            bn_mod(&r, &secp256k1.order);
+            scalar_multiply_jacobian(&secp256k1, &r, &jpoints[i].jp);
+            point_jacobian_add(&parent, &jpoints[i].jp, &secp256k1);
+        }
+        if(batchAffine(jpoints, n, points) != n){
+            count = 0;
+            break;
+        }
+        for(size_t i = 0; i < n; i++){
+            HDPublicKey * child = &children[offset+i];
+            memcpy(child->point, points[i].point, 64);
+            child->invalidateHash();
+            child->compressed = true;
+            child->keyIdentifierState = LAZY_EMPTY;
+        }
+    }
+    delete[] jpoints;
+    delete[] points;
+    return count;
+}
+HDPublicKey HDPublicKey::derive(const uint32_t * index, size_t len) const{
     HDPublicKey pk = *this;
-    for(size_t i=0; i<len; i++){
+    size_t start = 0;
+#if USE_BIP32_CACHE
+    bool useCache = (len > 1 && len-1 <= BIP32_CACHE_MAXDEPTH);
+    uint8_t base[32];
+    if(useCache){
+        SHA256 h;
+        h.write(chainCode, 32);
+        h.write(point, 64);
+        h.write(depth);
+        h.write((uint8_t)type);
+        h.write(network->xpub, 4);
+        h.end(base);
+        CacheLock lock;
+        int i = cacheFind(publicCacheEntries, base, index, len-1);
+        if(i >= 0){
+            pk = publicCacheNodes[i];
+            start = publicCacheEntries[i].len;
+        }
+    }
+#endif
+    for(size_t i=start; i<len; i++){
         pk = pk.child(index[i]);
+#if USE_BIP32_CACHE
+        if(useCache && i == len-2){
+            pk.computeIdentifier(); // parent fingerprint of every child
+            CacheLock lock;
+            bool evicted;
+            int slot = cacheSlot(publicCacheEntries, base, index, len-1, &evicted);
+            if(evicted){
+                publicCacheNodes[slot] = HDPublicKey();
+            }
+            publicCacheNodes[slot] = pk;
+        }
+#endif
     }
     return pk;
 }
-HDPublicKey HDPublicKey::derive(const char * path) const{
-    static const char VALID_CHARS[] = "0123456789/";
-    size_t len = strlen(path);
-    const char * cur = path;
-    if(path[0] == 'm'){ // remove leading "m/"
-        cur+=2;
-        len-=2;
-    }
-    if(cur[len-1] == '/'){ // remove trailing "/"
-        len--;
-    }
-    HDPublicKey pk;
-    size_t derivationLen = 1;
-    // checking if all chars are valid and counting derivation length
-    for(size_t i=0; i<len; i++){
-        const char * pch = strchr(VALID_CHARS, cur[i]);
-        if(pch == NULL){ // wrong character
-            return pk;
-        }
-        if(cur[i] == '/'){
-            derivationLen++;
-        }
-    }
-    uint32_t * derivation = (uint32_t *)calloc(derivationLen, sizeof(uint32_t));
-    size_t current = 0;
-    for(size_t i=0; i<len; i++){
-        if(cur[i] == '/'){ // next
-            if(derivation[current] >= 0x80000000){ // can't be hardened
-                free(derivation);
-                return pk;
-            }
-            current++;
-            continue;
-        }
-        const char * pch = strchr(VALID_CHARS, cur[i]);
-        uint32_t val = pch-VALID_CHARS;
-        derivation[current] = derivation[current]*10 + val;
+HDPublicKey HDPublicKey::derive(const DerivationPath& path) const{
+    if(!path.isValid() || path.isHardened()){
+        return HDPublicKey();
     }
-    return derive(derivation, derivationLen);
+    return derive(path.index, path.depth);
+}
+HDPublicKey HDPublicKey::derive(const char * path) const{
+    return derive(DerivationPath(path));
 }
 
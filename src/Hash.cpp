@@ -70,6 +70,11 @@ int sha256(const String data, uint8_t hash[32]){
 }
 #endif
 
+int sha256_many(const uint8_t * data, size_t len, size_t n, uint8_t * hashes){
+    sha256_Raw_many(data, len, n, hashes);
+    return 32*n;
+}
+
 int sha256Hmac(const uint8_t * key, size_t keyLen, const uint8_t * data, size_t dataLen, uint8_t hash[32]){
     hmac_sha256(key, keyLen, data, dataLen, hash);
     return 32;
@@ -102,7 +107,44 @@ size_t SHA256::endHMAC(uint8_t hmac[32]){
 /************************* Hash-160 **************************/
 /******************** rmd160( sha256( m ) ) ******************/
 
+// rmd160(sha256(data)) for messages up to 119 bytes (at most two sha256 blocks)
+// without hashing contexts, padding is written directly to the blocks
+static int hash160Short(const uint8_t * data, size_t len, uint8_t hash[20]){
+    uint8_t block[128] = { 0 };
+    uint32_t w[16];
+    uint32_t state[8];
+    size_t blocks = (len + 8) / 64 + 1;
+    uint64_t bits = ((uint64_t)len) << 3;
+    memcpy(block, data, len);
+    block[len] = 0x80;
+    for(int i=0; i<8; i++){
+        block[64*blocks-1-i] = (uint8_t)(bits >> (8*i));
+    }
+    memcpy(state, sha256_initial_hash_value, sizeof(state));
+    for(size_t b=0; b<blocks; b++){
+        for(int i=0; i<16; i++){
+            const uint8_t * p = block + 64*b + 4*i;
+            w[i] = ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | p[3];
+        }
+        sha256_Transform(state, w, state);
+    }
+    for(int i=0; i<8; i++){
+        block[4*i]   = (uint8_t)(state[i] >> 24);
+        block[4*i+1] = (uint8_t)(state[i] >> 16);
+        block[4*i+2] = (uint8_t)(state[i] >> 8);
+        block[4*i+3] = (uint8_t)state[i];
+    }
+    ripemd160_Raw32(block, hash);
+    memset(block, 0, sizeof(block));
+    memset(w, 0, sizeof(w));
+    memset(state, 0, sizeof(state));
+    return 20;
+}
+
 int hash160(const uint8_t * data, size_t len, uint8_t hash[20]){
+    if(len == 33 || len == 65){ // pubkeys
+        return hash160Short(data, len, hash);
+    }
     Hash160 h160;
     return hashData(&h160, data, len, hash);
 }
@@ -116,6 +158,33 @@ int hash160(const String data, uint8_t hash[20]){
 }
 #endif
 
+int hash160_33(const uint8_t data[33], uint8_t hash[20]){
+    return hash160Short(data, 33, hash);
+}
+int hash160_65(const uint8_t data[65], uint8_t hash[20]){
+    return hash160Short(data, 65, hash);
+}
+
+int hash160_many(const uint8_t * data, size_t len, size_t n, uint8_t * hashes){
+    uint8_t h[16*32]; // processing in chunks of 16 messages
+    size_t done = 0;
+    while(done < n){
+        size_t chunk = (n-done > 16) ? 16 : n-done;
+        if(sha256_GetLanes() == 1 && (len == 33 || len == 65)){
+            // no sha256 lanes, fused kernel is faster than contexts
+            for(size_t i=0; i<chunk; i++){
+                hash160Short(data+(done+i)*len, len, hashes+20*(done+i));
+            }
+        }else{
+            sha256_Raw_many(data+done*len, len, chunk, h);
+            ripemd160_Raw32_many(h, chunk, hashes+20*done);
+        }
+        done += chunk;
+    }
+    memset(h, 0, sizeof(h));
+    return 20*n;
+}
+
 size_t Hash160::end(uint8_t hash[20]){
     uint8_t h[32];
     sha256_Final(&ctx.ctx, h);
@@ -140,6 +209,20 @@ int doubleSha(const String data, uint8_t hash[32]){
 }
 #endif
 
+int doubleSha_many(const uint8_t * data, size_t len, size_t n, uint8_t * hashes){
+    sha256_Raw_many(data, len, n, hashes);
+    sha256_Raw_many(hashes, 32, n, hashes);
+    return 32*n;
+}
+int doubleSha64(const uint8_t data[64], uint8_t hash[32]){
+    sha256d64_Raw(data, hash);
+    return 32;
+}
+int doubleSha64_many(const uint8_t * data, size_t n, uint8_t * hashes){
+    sha256d64_Raw_many(data, n, hashes);
+    return 32*n;
+}
+
 size_t DoubleSha::end(uint8_t hash[32]){
     uint8_t h[32];
     sha256_Final(&ctx.ctx, h);
@@ -147,6 +230,163 @@ size_t DoubleSha::end(uint8_t hash[32]){
     return 32;
 }
 
+/*********************** Tagged hash *************************/
+/******* sha256( sha256(tag) || sha256(tag) || m ), BIP340 ****/
+
+static const char * const standardTags[TAG_STANDARD_COUNT] = {
+    "BIP0340/challenge",
+    "BIP0340/aux",
+    "BIP0340/nonce",
+    "TapLeaf",
+    "TapBranch",
+    "TapTweak",
+    "TapSighash",
+};
+
+// sha256 state after the sha256(tag) || sha256(tag) block
+static const uint32_t standardMidstates[TAG_STANDARD_COUNT][8] = {
+    // BIP0340/challenge
+    { 0x9cecba11, 0x23925381, 0x11679112, 0xd1627e0f,
+      0x97c87550, 0x003cc765, 0x90f61164, 0x33e9b66a },
+    // BIP0340/aux
+    { 0x24dd3219, 0x4eba7e70, 0xca0fabb9, 0x0fa3166d,
+      0x3afbe4b1, 0x4c44df97, 0x4aac2739, 0x249e850a },
+    // BIP0340/nonce
+    { 0x46615b35, 0xf4bfbff7, 0x9f8dc671, 0x83627ab3,
+      0x60217180, 0x57358661, 0x21a29e54, 0x68b07b4c },
+    // TapLeaf
+    { 0x9ce0e4e6, 0x7c116c39, 0x38b3caf2, 0xc30f5089,
+      0xd3f3936c, 0x47636e60, 0x7db33eea, 0xddc6f0c9 },
+    // TapBranch
+    { 0x23a865a9, 0xb8a40da7, 0x977c1e04, 0xc49e246f,
+      0xb5be1376, 0x9d24c9b7, 0xb583b5d4, 0xa8d226d2 },
+    // TapTweak
+    { 0xd129a2f3, 0x701c655d, 0x6583b6c3, 0xb9419727,
+      0x95f4e232, 0x94fd54f4, 0xa2ae8d85, 0x47ca590b },
+    // TapSighash
+    { 0xf504a425, 0xd7f8783b, 0x1363868a, 0xe3e55658,
+      0x6eee945d, 0xbc7888dd, 0x02a6e2c3, 0x1873fe9f },
+};
+
+// registered custom tags: sha256(tag) to find them by name and their midstates
+static uint8_t customTagHashes[TAGGED_HASH_CUSTOM_TAGS][32];
+static uint32_t customMidstates[TAGGED_HASH_CUSTOM_TAGS][8];
+static int customTagsLen = 0;
+
+static void tagMidstate(const uint8_t tagHash[32], uint32_t midstate[8]){
+    uint32_t w[16];
+    for(int i=0; i<8; i++){
+        w[i] = ((uint32_t)tagHash[4*i] << 24) | ((uint32_t)tagHash[4*i+1] << 16) |
+               ((uint32_t)tagHash[4*i+2] << 8) | tagHash[4*i+3];
+        w[i+8] = w[i];
+    }
+    sha256_Transform(sha256_initial_hash_value, w, midstate);
+}
+
+static int findCustomTag(const uint8_t tagHash[32]){
+    for(int i=0; i<customTagsLen; i++){
+        if(memcmp(customTagHashes[i], tagHash, 32) == 0){
+            return TAG_STANDARD_COUNT + i;
+        }
+    }
+    return -1;
+}
+
+int TaggedHash::registerTag(const uint8_t * tag, size_t tagLen){
+    uint8_t tagHash[32];
+    sha256(tag, tagLen, tagHash);
+    int id = findCustomTag(tagHash);
+    if(id >= 0){
+        return id;
+    }
+    if(customTagsLen >= TAGGED_HASH_CUSTOM_TAGS){
+        return -1;
+    }
+    memcpy(customTagHashes[customTagsLen], tagHash, 32);
+    tagMidstate(tagHash, customMidstates[customTagsLen]);
+    customTagsLen++;
+    return TAG_STANDARD_COUNT + customTagsLen - 1;
+}
+int TaggedHash::registerTag(const char * tag){
+    return registerTag((const uint8_t *)tag, strlen(tag));
+}
+
+TaggedHash::TaggedHash(int tagId){
+    valid = true;
+    if(tagId >= 0 && tagId < TAG_STANDARD_COUNT){
+        memcpy(midstate, standardMidstates[tagId], sizeof(midstate));
+    }else if(tagId >= TAG_STANDARD_COUNT && tagId < TAG_STANDARD_COUNT + customTagsLen){
+        memcpy(midstate, customMidstates[tagId - TAG_STANDARD_COUNT], sizeof(midstate));
+    }else{ // unknown id, refuse to hash with some other tag
+        valid = false;
+        memset(midstate, 0, sizeof(midstate));
+    }
+    begin();
+}
+TaggedHash::TaggedHash(const char * tag){
+    valid = true;
+    for(int i=0; i<TAG_STANDARD_COUNT; i++){
+        if(strcmp(tag, standardTags[i]) == 0){
+            memcpy(midstate, standardMidstates[i], sizeof(midstate));
+            begin();
+            return;
+        }
+    }
+    init((const uint8_t *)tag, strlen(tag));
+    begin();
+}
+TaggedHash::TaggedHash(const uint8_t * tag, size_t tagLen){
+    valid = true;
+    init(tag, tagLen);
+    begin();
+}
+void TaggedHash::init(const uint8_t * tag, size_t tagLen){
+    uint8_t tagHash[32];
+    sha256(tag, tagLen, tagHash);
+    int id = findCustomTag(tagHash);
+    if(id >= 0){
+        memcpy(midstate, customMidstates[id - TAG_STANDARD_COUNT], sizeof(midstate));
+    }else{
+        tagMidstate(tagHash, midstate);
+    }
+}
+void TaggedHash::begin(){
+    memcpy(ctx.state, midstate, sizeof(midstate));
+    ctx.bitcount = SHA256_BLOCK_LENGTH * 8;
+}
+size_t TaggedHash::write(const uint8_t * data, size_t len){
+    if(!valid){
+        return 0;
+    }
+    sha256_Update(&ctx, data, len);
+    return len;
+}
+size_t TaggedHash::write(uint8_t b){
+    if(!valid){
+        return 0;
+    }
+    sha256_Update(&ctx, &b, 1);
+    return 1;
+}
+size_t TaggedHash::end(uint8_t hash[32]){
+    if(!valid){
+        return 0;
+    }
+    sha256_Final(&ctx, hash);
+    return 32;
+}
+
+int taggedHash(int tagId, const uint8_t * data, size_t len, uint8_t hash[32]){
+    TaggedHash h(tagId);
+    h.write(data, len);
+    return h.end(hash);
+}
+int taggedHash(const char * tag, const uint8_t * data, size_t len, uint8_t hash[32]){
+    TaggedHash h(tag);
+    h.write(data, len);
+    return h.end(hash);
+}
+
 /************************** SHA-512 **************************/
 
 int sha512(const uint8_t * data, size_t len, uint8_t hash[64]){
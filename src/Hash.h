@@ -51,6 +51,11 @@ int sha256(const char * data, size_t len, uint8_t hash[32]);
 int sha256(const String data, uint8_t hash[32]);
 #endif
 
+/** \brief sha256 of n messages of len bytes each stored one after another.
+ *         Hashes are written one after another → n*32 bytes output.
+ *         Messages are hashed in parallel when the CPU allows it. */
+int sha256_many(const uint8_t * data, size_t len, size_t n, uint8_t * hashes);
+
 int sha256Hmac(const uint8_t * key, size_t keyLen, const uint8_t * data, size_t dataLen, uint8_t hash[32]);
 
 class SHA256 : public HashAlgorithm{
@@ -76,6 +81,12 @@ int hash160(const char * data, size_t len, uint8_t hash[20]);
 #if USE_ARDUINO_STRING
 int hash160(const String data, uint8_t hash[20]);
 #endif
+/** \brief hash160 of a 33-byte compressed pubkey without hashing contexts → 20 bytes output */
+int hash160_33(const uint8_t data[33], uint8_t hash[20]);
+/** \brief hash160 of a 65-byte uncompressed pubkey without hashing contexts → 20 bytes output */
+int hash160_65(const uint8_t data[65], uint8_t hash[20]);
+/** \brief hash160 of n messages of len bytes each (e.g. 33-byte pubkeys) → n*20 bytes output */
+int hash160_many(const uint8_t * data, size_t len, size_t n, uint8_t * hashes);
 
 class Hash160 : public SHA256{
 public:
@@ -91,12 +102,69 @@ int doubleSha(const char * data, size_t len, uint8_t hash[32]);
 #if USE_ARDUINO_STRING
 int doubleSha(const String data, uint8_t hash[32]);
 #endif
+/** \brief doubleSha of n messages of len bytes each (e.g. 64-byte merkle nodes) → n*32 bytes output */
+int doubleSha_many(const uint8_t * data, size_t len, size_t n, uint8_t * hashes);
+/** \brief doubleSha of exactly 64 bytes (merkle node) → 32 bytes output */
+int doubleSha64(const uint8_t data[64], uint8_t hash[32]);
+/** \brief doubleSha64 of n 64-byte messages → n*32 bytes output.
+ *         Pass 2n nodes of a merkle level to get n nodes of the next one,
+ *         hashes can point to data to compute the level in place. */
+int doubleSha64_many(const uint8_t * data, size_t n, uint8_t * hashes);
 
 class DoubleSha : public SHA256{
 public:
     size_t end(uint8_t hash[32]);
 };
 
+/*********************** Tagged hash *************************/
+/******* sha256( sha256(tag) || sha256(tag) || m ), BIP340 ****/
+
+/** \brief Standard BIP340 / BIP341 tags with precomputed midstates */
+enum TaggedHashTag{
+    TAG_BIP340_CHALLENGE,
+    TAG_BIP340_AUX,
+    TAG_BIP340_NONCE,
+    TAG_TAP_LEAF,
+    TAG_TAP_BRANCH,
+    TAG_TAP_TWEAK,
+    TAG_TAP_SIGHASH,
+    /** \brief number of standard tags, ids of registered tags start here */
+    TAG_STANDARD_COUNT
+};
+
+/** \brief tagged hash one-line hashing function → 32 bytes output, 0 for an unknown tag id */
+int taggedHash(int tagId, const uint8_t * data, size_t len, uint8_t hash[32]);
+int taggedHash(const char * tag, const uint8_t * data, size_t len, uint8_t hash[32]);
+
+/** \brief Tagged hash starting from the midstate after the sha256(tag) || sha256(tag) block.
+ *         Standard tags are baked in, custom tags can be registered with registerTag()
+ *         to skip the tag block as well. Copy the object to reuse a hashed prefix. */
+class TaggedHash : public HashAlgorithm{
+public:
+    /** \brief one of TaggedHashTag or an id returned by registerTag().
+     *         Unknown ids make the object invalid, write() and end() return 0 then. */
+    TaggedHash(int tagId = TAG_BIP340_CHALLENGE);
+    /** \brief finds standard or registered tag by name, computes the midstate otherwise */
+    TaggedHash(const char * tag);
+    TaggedHash(const uint8_t * tag, size_t tagLen);
+    /** \brief restarts hashing from the tag midstate */
+    void begin();
+    size_t write(const uint8_t * data, size_t len);
+    size_t write(uint8_t b);
+    size_t end(uint8_t hash[32]);
+    /** \brief false if the object was constructed with an unknown tag id */
+    bool isValid() const{ return valid; };
+    /** \brief stores the midstate of a custom tag, call it at startup (not thread-safe).
+     *         Returns tag id to use in the constructor or -1 if there is no free slot. */
+    static int registerTag(const uint8_t * tag, size_t tagLen);
+    static int registerTag(const char * tag);
+protected:
+    void init(const uint8_t * tag, size_t tagLen);
+    uint32_t midstate[8];
+    SHA256_CTX ctx;
+    bool valid;
+};
+
 /************************** SHA-512 **************************/
 
 int sha512Hmac(const uint8_t * key, size_t keyLen, const uint8_t * data, size_t dataLen, uint8_t hash[64]);
@@ -341,7 +341,7 @@ int PSBT::add(uint8_t section, const Script * k, const Script * v){
 				}
 				memcpy(der.fingerprint, val_arr+lenVarInt(v->length()), 4);
 				der.derivationLen = (v->length()-lenVarInt(v->length())-4)/sizeof(uint32_t);
-				der.derivation = (uint32_t *)calloc(der.derivationLen, sizeof(uint32_t));
+				der.derivation = new uint32_t[der.derivationLen];
 				for(size_t i=0; i<der.derivationLen; i++){
 					der.derivation[i] = littleEndianToInt(val_arr+lenVarInt(v->length())+4*(i+1),4);
 				}
@@ -403,7 +403,7 @@ int PSBT::add(uint8_t section, const Script * k, const Script * v){
 				}
 				memcpy(der.fingerprint, val_arr+lenVarInt(v->length()), 4);
 				der.derivationLen = (v->length()-lenVarInt(v->length())-4)/sizeof(uint32_t);
-				der.derivation = (uint32_t *)calloc(der.derivationLen, sizeof(uint32_t));
+				der.derivation = new uint32_t[der.derivationLen];
 				for(size_t i=0; i<der.derivationLen; i++){
 					der.derivation[i] = littleEndianToInt(val_arr+lenVarInt(v->length())+4*(i+1),4);
 				}
@@ -563,32 +563,34 @@ uint8_t PSBT::sign(const HDPrivateKey root){
 	root.fingerprint(fingerprint);
 	uint8_t counter = 0;
 	// in most cases only one account key is required, so we can cache it
-	uint32_t * first_derivation = NULL;
-	uint8_t first_derivation_len = 0;
+	DerivationPath accountPath;
+	bool accountReady = false;
 	HDPrivateKey account;
 	for(size_t i=0; i<tx.inputsNumber; i++){
 		if(txInsMeta[i].derivationsLen > 0){
 			for(size_t j=0; j<txInsMeta[i].derivationsLen; j++){
 				if(memcmp(fingerprint, txInsMeta[i].derivations[j].fingerprint, 4) == 0){
-					// caching account key here
-					if(first_derivation == NULL){
-						first_derivation = txInsMeta[i].derivations[j].derivation; 
-						first_derivation_len = 0;
-						for(size_t k=0; k < txInsMeta[i].derivations[j].derivationLen; k++){
-							if(txInsMeta[i].derivations[j].derivation[k] >= 0x80000000){
-								first_derivation_len++;
-							}else{
-								break;
-							}
-						}
-						account = root.derive(first_derivation, first_derivation_len);
-					}
+					DerivationPath path(txInsMeta[i].derivations[j].derivation, txInsMeta[i].derivations[j].derivationLen);
 					PrivateKey pk;
-					// checking if cached key is ok
-					if(memcmp(first_derivation, txInsMeta[i].derivations[j].derivation, first_derivation_len*sizeof(uint32_t))==0){
-						pk = account.derive(txInsMeta[i].derivations[j].derivation+first_derivation_len, txInsMeta[i].derivations[j].derivationLen - first_derivation_len);
-					}else{
+					if(!path.isValid()){
+						// deeper than DERIVATION_PATH_MAX_DEPTH, derived without the cached account
 						pk = root.derive(txInsMeta[i].derivations[j].derivation, txInsMeta[i].derivations[j].derivationLen);
+					}else{
+						// caching account key here - hardened part of the path
+						if(!accountReady){
+							accountPath = DerivationPath();
+							for(size_t k=0; k < path.depth && path[k] >= 0x80000000; k++){
+								accountPath.push(path[k]);
+							}
+							account = root.derive(accountPath);
+							accountReady = true;
+						}
+						// checking if cached key is ok
+						if(path.startsWith(accountPath)){
+							pk = account.derive(path.index+accountPath.depth, path.depth-accountPath.depth);
+						}else{
+							pk = root.derive(path);
+						}
 					}
 					if(txInsMeta[i].derivations[j].pubkey == pk.publicKey()){
 						// can sign - let's sign
@@ -0,0 +1,556 @@
+#include "Scanner.h"
+#include "Hash.h"
+#include "OpCodes.h"
+#include "Conversion.h"
+#include "Snapshot.h"
+
+#include <stdint.h>
+#include <string.h>
+#include <stdlib.h>
+#include "utility/trezor/ecdsa.h"
+#include "utility/trezor/secp256k1.h"
+
+#if USE_STD_THREAD
+#include <thread>
+#include <vector>
+#include <atomic>
+#endif
+
+// number of work units per thread in one round,
+// keeps threads busy while the calling thread passes records to the sink
+#define SCAN_UNITS_PER_THREAD 4
+
+static const uint32_t defaultChains[] = { 0, 1 };
+
+size_t scriptPubkeyFromKeyHash(const uint8_t keyHash[20], ScriptType type, uint8_t * script, size_t len){
+    switch(type){
+        case P2PKH:
+            if(len < 25){
+                return 0;
+            }
+            script[0] = OP_DUP;
+            script[1] = OP_HASH160;
+            script[2] = 20;
+            memcpy(script+3, keyHash, 20);
+            script[23] = OP_EQUALVERIFY;
+            script[24] = OP_CHECKSIG;
+            return 25;
+        case P2WPKH:
+            if(len < 22){
+                return 0;
+            }
+            script[0] = OP_0;
+            script[1] = 20;
+            memcpy(script+2, keyHash, 20);
+            return 22;
+        case P2SH_P2WPKH: {
+            if(len < 23){
+                return 0;
+            }
+            uint8_t redeem[22];
+            scriptPubkeyFromKeyHash(keyHash, P2WPKH, redeem, sizeof(redeem));
+            script[0] = OP_HASH160;
+            script[1] = 20;
+            hash160(redeem, sizeof(redeem), script+2);
+            script[22] = OP_EQUAL;
+            return 23;
+        }
+        default:
+            return 0;
+    }
+}
+
+// parameters shared by all workers
+typedef struct{
+    const HDPublicKey * accounts;
+    const uint32_t * chains;
+    size_t chainsLen;
+    uint32_t start;
+    uint32_t end;
+    size_t blocksPerChain;
+    ScriptType type;
+} ScanJob;
+
+bool scanScratchInit(ScanScratch * s, size_t capacity){
+    s->keys = new HDPublicKey[capacity];
+    s->secs = (uint8_t *)calloc(capacity, 33);
+    s->hashes = (uint8_t *)calloc(capacity, 20);
+    s->capacity = capacity;
+    return (s->keys != NULL && s->secs != NULL && s->hashes != NULL);
+}
+void scanScratchFree(ScanScratch * s){
+    delete[] s->keys;
+    free(s->secs);
+    free(s->hashes);
+    s->keys = NULL;
+    s->secs = NULL;
+    s->hashes = NULL;
+    s->capacity = 0;
+}
+
+size_t deriveRecords(const HDPublicKey &chainKey, size_t account, uint32_t from, uint32_t to,
+                     ScriptType type, ScanScratch * s, ScanRecord * out){
+    if(to <= from || to - from > s->capacity){
+        return 0;
+    }
+    size_t n = to - from;
+    if(type == UNKNOWN_TYPE){
+        type = chainKey.type;
+    }
+    if(type != P2WPKH && type != P2SH_P2WPKH){
+        type = P2PKH;
+    }
+    if(chainKey.deriveRange(from, to, s->keys) != n){
+        return 0;
+    }
+    for(size_t i = 0; i < n; i++){
+        s->secs[33*i] = 0x02 + (s->keys[i].point[63] & 0x01);
+        memcpy(s->secs+33*i+1, s->keys[i].point, 32);
+    }
+    hash160_many(s->secs, 33, n, s->hashes);
+    for(size_t i = 0; i < n; i++){
+        ScanRecord * r = &out[i];
+        r->account = account;
+        r->chain = chainKey.childNumber;
+        r->index = from + i;
+        memcpy(r->pubkey, s->secs+33*i, 33);
+        memcpy(r->keyHash, s->hashes+20*i, 20);
+        r->scriptLen = scriptPubkeyFromKeyHash(r->keyHash, (type == P2SH_P2WPKH) ? P2WPKH : type, r->scriptPubkey, sizeof(r->scriptPubkey));
+    }
+    if(type == P2SH_P2WPKH){
+        // redeem scripts are hashed in bulk as well
+        for(size_t i = 0; i < n; i++){
+            memcpy(s->secs+22*i, out[i].scriptPubkey, 22);
+        }
+        hash160_many(s->secs, 22, n, s->hashes);
+        for(size_t i = 0; i < n; i++){
+            ScanRecord * r = &out[i];
+            r->scriptPubkey[0] = OP_HASH160;
+            r->scriptPubkey[1] = 20;
+            memcpy(r->scriptPubkey+2, s->hashes+20*i, 20);
+            r->scriptPubkey[22] = OP_EQUAL;
+            r->scriptLen = 23;
+        }
+    }
+    return n;
+}
+
+// derives one block of indexes of one chain, returns number of records
+static size_t scanUnit(const ScanJob * job, size_t unit, ScanScratch * s, ScanRecord * out){
+    size_t account = unit / (job->chainsLen * job->blocksPerChain);
+    size_t rest = unit % (job->chainsLen * job->blocksPerChain);
+    uint32_t chain = job->chains[rest / job->blocksPerChain];
+    uint32_t from = job->start + (rest % job->blocksPerChain) * SCAN_BLOCK_SIZE;
+    uint32_t to = (job->end - from > SCAN_BLOCK_SIZE) ? from + SCAN_BLOCK_SIZE : job->end;
+
+    HDPublicKey chainKey = job->accounts[account].child(chain);
+    return deriveRecords(chainKey, account, from, to, job->type, s, out);
+}
+
+// processes units [first, first+count), unit first+i writes to records+i*SCAN_BLOCK_SIZE
+#if USE_STD_THREAD
+static void scanWorker(const ScanJob * job, size_t first, size_t count, std::atomic<size_t> * next, ScanRecord * records, size_t * counts){
+    ScanScratch s;
+    if(!scanScratchInit(&s, SCAN_BLOCK_SIZE)){
+        scanScratchFree(&s);
+        return;
+    }
+    size_t i;
+    while((i = next->fetch_add(1)) < count){
+        counts[i] = scanUnit(job, first+i, &s, records+i*SCAN_BLOCK_SIZE);
+    }
+    scanScratchFree(&s);
+}
+#endif
+
+static size_t emitRecords(const ScanRecord * records, const size_t * counts, size_t units, ScanSink sink, void * ctx){
+    size_t total = 0;
+    for(size_t i = 0; i < units; i++){
+        for(size_t j = 0; j < counts[i]; j++){
+            sink(&records[i*SCAN_BLOCK_SIZE+j], ctx);
+        }
+        total += counts[i];
+    }
+    return total;
+}
+
+size_t scanAccounts(const HDPublicKey * accounts, size_t accountsLen,
+                    const uint32_t * chains, size_t chainsLen,
+                    uint32_t start, uint32_t end, ScriptType type,
+                    ScanSink sink, void * ctx, unsigned int threads){
+    if(chains == NULL){
+        chains = defaultChains;
+        chainsLen = sizeof(defaultChains)/sizeof(defaultChains[0]);
+    }
+    if(accounts == NULL || sink == NULL || accountsLen == 0 || chainsLen == 0 || end <= start || end > 0x80000000){
+        return 0;
+    }
+    for(size_t i = 0; i < chainsLen; i++){
+        if(chains[i] >= 0x80000000){
+            return 0;
+        }
+    }
+    ScanJob job;
+    job.accounts = accounts;
+    job.chains = chains;
+    job.chainsLen = chainsLen;
+    job.start = start;
+    job.end = end;
+    job.blocksPerChain = (end - start + SCAN_BLOCK_SIZE - 1) / SCAN_BLOCK_SIZE;
+    job.type = type;
+    size_t units = accountsLen * chainsLen * job.blocksPerChain;
+    size_t total = 0;
+
+#if USE_STD_THREAD
+    if(threads == 0){
+        threads = std::thread::hardware_concurrency();
+    }
+    if(threads > 1 && units > 1){
+#if USE_WIDE_CP
+        scalar_multiply_init(&secp256k1);
+#endif
+        size_t roundUnits = threads * SCAN_UNITS_PER_THREAD;
+        if(roundUnits > units){
+            roundUnits = units;
+        }
+        // double buffering: workers fill one round while the sink consumes the previous one
+        ScanRecord * records[2];
+        size_t * counts[2];
+        for(int k = 0; k < 2; k++){
+            records[k] = new ScanRecord[roundUnits * SCAN_BLOCK_SIZE];
+            counts[k] = new size_t[roundUnits];
+        }
+        size_t prevUnits = 0;
+        for(size_t first = 0, round = 0; first < units || prevUnits > 0; round++){
+            size_t cur = round & 1;
+            size_t n = (units - first < roundUnits) ? (units - first) : roundUnits;
+            memset(counts[cur], 0, roundUnits * sizeof(size_t));
+            std::atomic<size_t> next(0);
+            std::vector<std::thread> pool;
+            unsigned int workers = (n < threads) ? n : threads;
+            for(unsigned int i = 0; i < workers; i++){
+                pool.push_back(std::thread(scanWorker, &job, first, n, &next, records[cur], counts[cur]));
+            }
+            total += emitRecords(records[cur ^ 1], counts[cur ^ 1], prevUnits, sink, ctx);
+            for(size_t i = 0; i < pool.size(); i++){
+                pool[i].join();
+            }
+            first += n;
+            prevUnits = n;
+        }
+        for(int k = 0; k < 2; k++){
+            delete[] records[k];
+            delete[] counts[k];
+        }
+        return total;
+    }
+#else
+    (void)threads;
+#endif
+    ScanScratch s;
+    ScanRecord * records = new ScanRecord[SCAN_BLOCK_SIZE];
+    if(scanScratchInit(&s, SCAN_BLOCK_SIZE)){
+        for(size_t u = 0; u < units; u++){
+            size_t n = scanUnit(&job, u, &s, records);
+            total += emitRecords(records, &n, 1, sink, ctx);
+        }
+    }
+    scanScratchFree(&s);
+    delete[] records;
+    return total;
+}
+
+// ---------------------------------------------------------------- ScriptIndex class
+
+// empty slots have index set to this value, derived indexes are always below it
+#define SCRIPT_INDEX_EMPTY 0xFFFFFFFF
+
+ScriptIndex::ScriptIndex(){
+    entries = NULL;
+    capacity = 0;
+    count = 0;
+}
+ScriptIndex::~ScriptIndex(){
+    clear();
+}
+ScriptIndex::ScriptIndex(const ScriptIndex &other){
+    entries = NULL;
+    capacity = 0;
+    count = 0;
+    *this = other;
+}
+ScriptIndex &ScriptIndex::operator=(const ScriptIndex &other){
+    if(this == &other){
+        return *this;
+    }
+    clear();
+    if(other.capacity > 0){
+        entries = (ScriptIndexEntry *)calloc(other.capacity, sizeof(ScriptIndexEntry));
+        if(entries == NULL){
+            return *this;
+        }
+        memcpy(entries, other.entries, other.capacity * sizeof(ScriptIndexEntry));
+        capacity = other.capacity;
+        count = other.count;
+    }
+    return *this;
+}
+void ScriptIndex::clear(){
+    free(entries);
+    entries = NULL;
+    capacity = 0;
+    count = 0;
+}
+// hashes are uniformly distributed already, first bytes are used as a slot number
+size_t ScriptIndex::slot(const uint8_t hash[20]) const{
+    return (size_t)littleEndianToInt(hash, sizeof(size_t)) & (capacity - 1);
+}
+bool ScriptIndex::grow(size_t newCapacity){
+    ScriptIndexEntry * old = entries;
+    size_t oldCapacity = capacity;
+    entries = (ScriptIndexEntry *)calloc(newCapacity, sizeof(ScriptIndexEntry));
+    if(entries == NULL){
+        entries = old;
+        return false;
+    }
+    memset(entries, 0xFF, newCapacity * sizeof(ScriptIndexEntry));
+    capacity = newCapacity;
+    count = 0;
+    for(size_t i = 0; i < oldCapacity; i++){
+        if(old[i].index != SCRIPT_INDEX_EMPTY){
+            insert(old[i].hash, old[i].redeemScript, old[i].account, old[i].chain, old[i].index);
+        }
+    }
+    free(old);
+    return true;
+}
+bool ScriptIndex::reserve(size_t n){
+    size_t newCapacity = (capacity > 0) ? capacity : 16;
+    while(newCapacity / 4 * 3 < n){
+        newCapacity *= 2;
+    }
+    if(newCapacity == capacity){
+        return true;
+    }
+    return grow(newCapacity);
+}
+bool ScriptIndex::insert(const uint8_t hash[20], bool redeemScript, uint32_t account, uint32_t chain, uint32_t index){
+    if(chain >= 0x80000000 || !reserve(count+1)){
+        return false;
+    }
+    size_t i = slot(hash);
+    while(entries[i].index != SCRIPT_INDEX_EMPTY &&
+          (entries[i].redeemScript != redeemScript || memcmp(entries[i].hash, hash, 20) != 0)){
+        i = (i + 1) & (capacity - 1);
+    }
+    if(entries[i].index == SCRIPT_INDEX_EMPTY){
+        memcpy(entries[i].hash, hash, 20);
+        entries[i].redeemScript = redeemScript;
+        count++;
+    }
+    entries[i].account = account;
+    entries[i].chain = chain;
+    entries[i].index = index;
+    return true;
+}
+bool ScriptIndex::add(const ScanRecord * record, size_t firstAccount){
+    uint32_t account = firstAccount + record->account;
+    if(!insert(record->keyHash, false, account, record->chain, record->index)){
+        return false;
+    }
+    // P2SH_P2WPKH, scriptPubkey commits to the redeem script
+    if(record->scriptLen == 23){
+        return insert(record->scriptPubkey+2, true, account, record->chain, record->index);
+    }
+    return true;
+}
+
+typedef struct{
+    ScriptIndex * index;
+    size_t firstAccount;
+    size_t added;
+} ScriptIndexSink;
+
+static void addToIndex(const ScanRecord * record, void * ctx){
+    ScriptIndexSink * s = (ScriptIndexSink *)ctx;
+    if(s->index->add(record, s->firstAccount)){
+        s->added++;
+    }
+}
+size_t ScriptIndex::add(const HDPublicKey * accounts, size_t accountsLen, size_t firstAccount,
+                        const uint32_t * chains, size_t chainsLen,
+                        uint32_t start, uint32_t end, ScriptType type,
+                        unsigned int threads){
+    if(end <= start){
+        return 0;
+    }
+    size_t n = accountsLen * ((chains == NULL) ? 2 : chainsLen) * (end - start);
+    if(!reserve(count + n)){
+        return 0;
+    }
+    ScriptIndexSink s;
+    s.index = this;
+    s.firstAccount = firstAccount;
+    s.added = 0;
+    scanAccounts(accounts, accountsLen, chains, chainsLen, start, end, type, addToIndex, &s, threads);
+    return s.added;
+}
+size_t ScriptIndex::add(const KeySnapshot &snapshot, size_t account, ScriptType type){
+    uint32_t count = snapshot.count();
+    if(count == 0){
+        return 0;
+    }
+    if(type == UNKNOWN_TYPE){
+        type = snapshot.account().type;
+    }
+    if(!reserve(this->count + ((type == P2SH_P2WPKH) ? 2 : 1) * (size_t)count)){
+        return 0;
+    }
+    uint32_t start = snapshot.start();
+    uint32_t chain = snapshot.chain();
+    bool hasHashes = (snapshot.contents() & SNAPSHOT_HASHES);
+    uint8_t * buf = (uint8_t *)calloc(SCAN_BLOCK_SIZE, 22);
+    uint8_t * hashes = (uint8_t *)calloc(SCAN_BLOCK_SIZE, 20);
+    if(buf == NULL || hashes == NULL){
+        free(buf);
+        free(hashes);
+        return 0;
+    }
+    size_t added = 0;
+    for(uint32_t offset = 0; offset < count; offset += SCAN_BLOCK_SIZE){
+        uint32_t n = (count - offset > SCAN_BLOCK_SIZE) ? SCAN_BLOCK_SIZE : count - offset;
+        const uint8_t * keyHashes;
+        if(hasHashes){
+            keyHashes = snapshot.keyHash(start + offset);
+        }else{
+            // only public keys are stored, hashes are calculated in bulk
+            hash160_many(snapshot.pubkey(start + offset), 33, n, hashes);
+            keyHashes = hashes;
+        }
+        for(uint32_t i = 0; i < n; i++){
+            if(insert(keyHashes + 20*i, false, account, chain, start + offset + i)){
+                added++;
+            }
+        }
+        if(type == P2SH_P2WPKH){
+            for(uint32_t i = 0; i < n; i++){
+                scriptPubkeyFromKeyHash(keyHashes + 20*i, P2WPKH, buf + 22*i, 22);
+            }
+            hash160_many(buf, 22, n, hashes);
+            for(uint32_t i = 0; i < n; i++){
+                insert(hashes + 20*i, true, account, chain, start + offset + i);
+            }
+        }
+    }
+    free(buf);
+    free(hashes);
+    return added;
+}
+const ScriptIndexEntry * ScriptIndex::lookup(const uint8_t hash[20], bool redeemScript) const{
+    if(count == 0){
+        return NULL;
+    }
+    size_t i = slot(hash);
+    while(entries[i].index != SCRIPT_INDEX_EMPTY){
+        if(entries[i].redeemScript == redeemScript && memcmp(entries[i].hash, hash, 20) == 0){
+            return &entries[i];
+        }
+        i = (i + 1) & (capacity - 1);
+    }
+    return NULL;
+}
+const ScriptIndexEntry * ScriptIndex::find(const uint8_t hash[20]) const{
+    return lookup(hash, false);
+}
+const ScriptIndexEntry * ScriptIndex::findRedeemScript(const uint8_t hash[20]) const{
+    return lookup(hash, true);
+}
+const ScriptIndexEntry * ScriptIndex::find(const uint8_t * script, size_t len) const{
+    if(len == 25 && script[0] == OP_DUP && script[1] == OP_HASH160 && script[2] == 20
+       && script[23] == OP_EQUALVERIFY && script[24] == OP_CHECKSIG){
+        return find(script+3);
+    }
+    if(len == 23 && script[0] == OP_HASH160 && script[1] == 20 && script[22] == OP_EQUAL){
+        return findRedeemScript(script+2);
+    }
+    if(len == 22 && script[0] == OP_0 && script[1] == 20){
+        return find(script+2);
+    }
+    return NULL;
+}
+const ScriptIndexEntry * ScriptIndex::find(const Script &scriptPubkey) const{
+    uint8_t script[SCAN_MAX_SCRIPT_LEN];
+    size_t len = scriptPubkey.serializeScript(script, sizeof(script));
+    if(len == 0){
+        return NULL;
+    }
+    return find(script, len);
+}
+const ScriptIndexEntry * ScriptIndex::find(const PublicKey &pubkey) const{
+    uint8_t hash[20];
+    pubkey.keyHash(hash);
+    return find(hash);
+}
+size_t ScriptIndex::matchOutputs(const Tx &tx, const ScriptIndexEntry ** matches) const{
+    size_t found = 0;
+    for(size_t i = 0; i < tx.outputsNumber; i++){
+        matches[i] = find(tx.txOuts[i].scriptPubkey);
+        if(matches[i] != NULL){
+            found++;
+        }
+    }
+    return found;
+}
+// copies compressed public key spending the input to sec, returns false if there is none
+static bool inputPubkey(const TxIn &txIn, uint8_t sec[33]){
+    if(txIn.isSegwit()){
+        // <sig> <pubkey>
+        if(txIn.witness.count() != 2 || txIn.witness.element(1, sec, 33) != 33){
+            return false;
+        }
+        return (sec[0] == 0x02 || sec[0] == 0x03);
+    }
+    // P2PKH: <sig> <pubkey>, pubkey is the last push
+    uint8_t script[110];
+    size_t len = txIn.scriptSig.serializeScript(script, sizeof(script));
+    if(len < 35 || script[len-34] != 33){
+        return false;
+    }
+    memcpy(sec, script+len-33, 33);
+    return (sec[0] == 0x02 || sec[0] == 0x03);
+}
+size_t ScriptIndex::matchInputs(const Tx &tx, const ScriptIndexEntry ** matches) const{
+    // public keys are hashed in bulk, in chunks of SCAN_BLOCK_SIZE inputs
+    uint8_t * secs = (uint8_t *)calloc(SCAN_BLOCK_SIZE, 33);
+    size_t * inputs = (size_t *)calloc(SCAN_BLOCK_SIZE, sizeof(size_t));
+    uint8_t * hashes = (uint8_t *)calloc(SCAN_BLOCK_SIZE, 20);
+    size_t found = 0;
+    if(secs == NULL || inputs == NULL || hashes == NULL){
+        free(secs);
+        free(inputs);
+        free(hashes);
+        return 0;
+    }
+    size_t i = 0;
+    while(i < tx.inputsNumber){
+        size_t n = 0;
+        for(; i < tx.inputsNumber && n < SCAN_BLOCK_SIZE; i++){
+            matches[i] = NULL;
+            if(inputPubkey(tx.txIns[i], secs+33*n)){
+                inputs[n] = i;
+                n++;
+            }
+        }
+        hash160_many(secs, 33, n, hashes);
+        for(size_t j = 0; j < n; j++){
+            matches[inputs[j]] = find(hashes+20*j);
+            if(matches[inputs[j]] != NULL){
+                found++;
+            }
+        }
+    }
+    free(secs);
+    free(inputs);
+    free(hashes);
+    return found;
+}
@@ -0,0 +1,158 @@
+#ifndef __SCANNER_H__
+#define __SCANNER_H__
+
+#include "Bitcoin.h"
+
+class KeySnapshot;
+
+/** \brief Number of consecutive indexes derived by a worker in one go */
+#ifndef SCAN_BLOCK_SIZE
+#define SCAN_BLOCK_SIZE 256
+#endif
+
+/** \brief Maximum length of the scriptPubkey in ScanRecord (P2PKH) */
+#define SCAN_MAX_SCRIPT_LEN 25
+
+/** \brief A single derived scriptPubkey: accounts[account]/chain/index */
+typedef struct{
+    /** \brief index of the account in the accounts array */
+    size_t account;
+    uint32_t chain;
+    uint32_t index;
+    /** \brief compressed public key */
+    uint8_t pubkey[33];
+    /** \brief hash160 of the compressed public key */
+    uint8_t keyHash[20];
+    uint8_t scriptPubkey[SCAN_MAX_SCRIPT_LEN];
+    uint8_t scriptLen;
+} ScanRecord;
+
+/** \brief Callback receiving scan records, ctx is passed as is */
+typedef void (*ScanSink)(const ScanRecord * record, void * ctx);
+
+/** \brief Writes scriptPubkey of the type (P2PKH, P2WPKH or P2SH_P2WPKH)
+ *         for a public key hash. Returns script length, 0 for other types.
+ */
+size_t scriptPubkeyFromKeyHash(const uint8_t keyHash[20], ScriptType type, uint8_t * script, size_t len);
+
+/** \brief Scratch memory to derive up to `capacity` records at once with deriveRecords() */
+typedef struct{
+    HDPublicKey * keys;
+    uint8_t * secs;
+    uint8_t * hashes;
+    size_t capacity;
+} ScanScratch;
+
+/** \brief Allocates scratch memory for `capacity` records, returns false if out of memory.
+ *         Call scanScratchFree() in any case. */
+bool scanScratchInit(ScanScratch * s, size_t capacity);
+void scanScratchFree(ScanScratch * s);
+
+/** \brief Derives records chainKey/from ... chainKey/(to-1) into `out`, chain is the child number of chainKey.
+ *         If type is UNKNOWN_TYPE the type of the chain key is used (P2PKH if not set).
+ *         Returns number of records, 0 if the range doesn't fit into the scratch or on derivation error.
+ */
+size_t deriveRecords(const HDPublicKey &chainKey, size_t account, uint32_t from, uint32_t to,
+                     ScriptType type, ScanScratch * s, ScanRecord * out);
+
+/** \brief Derives scriptPubkeys for indexes from `start` to `end` (not including `end`)
+ *         on every chain of every account: `accounts[i]/chains[j]/index`.
+ *         chains can be NULL - receive and change chains (0 and 1) are used.
+ *         If type is UNKNOWN_TYPE the type of every account is used (P2PKH if not set).
+ *
+ *         Records are passed to the sink sorted by account, chain and index,
+ *         from the calling thread. With USE_STD_THREAD derivation runs
+ *         in `threads` threads (0 - one per CPU core).
+ *         Returns number of records passed to the sink.
+ */
+size_t scanAccounts(const HDPublicKey * accounts, size_t accountsLen,
+                    const uint32_t * chains, size_t chainsLen,
+                    uint32_t start, uint32_t end, ScriptType type,
+                    ScanSink sink, void * ctx, unsigned int threads = 0);
+
+/** \brief ScriptIndex entry: hash160 of the public key or of the P2SH redeem script
+ *         and the derivation path of the key relative to the account xpub */
+typedef struct{
+    uint8_t hash[20];
+    uint32_t account;
+    uint32_t chain : 31;
+    /** \brief 1 if hash is hash160 of the P2SH redeem script, 0 if of the public key */
+    uint32_t redeemScript : 1;
+    uint32_t index;
+} ScriptIndexEntry;
+
+/**
+ *  \brief Maps scriptPubkeys and public keys to derivation paths of watched accounts.
+ *
+ *  Keys are hash160 of the public keys, for P2SH_P2WPKH accounts
+ *  hash160 of the redeem scripts are stored as well.
+ *  Open addressing hash table, 32 bytes per entry, load factor is kept below 3/4.
+ *  Ranges can be added at any time, for example when the gap limit advances.
+ */
+class ScriptIndex{
+protected:
+    ScriptIndexEntry * entries;
+    /** \brief number of slots, power of 2 */
+    size_t capacity;
+    size_t count;
+    bool grow(size_t capacity);
+    bool insert(const uint8_t hash[20], bool redeemScript, uint32_t account, uint32_t chain, uint32_t index);
+    size_t slot(const uint8_t hash[20]) const;
+    const ScriptIndexEntry * lookup(const uint8_t hash[20], bool redeemScript) const;
+public:
+    ScriptIndex();
+    ~ScriptIndex();
+    ScriptIndex(const ScriptIndex &other); // copy
+    ScriptIndex &operator=(const ScriptIndex &other); // assignment
+
+    /** \brief number of entries */
+    size_t size() const{ return count; };
+    /** \brief memory allocated by the index in bytes */
+    size_t memoryUsage() const{ return capacity * sizeof(ScriptIndexEntry); };
+    /** \brief removes all entries and frees memory */
+    void clear();
+    /** \brief allocates memory for `n` entries in total to avoid rehashing while adding */
+    bool reserve(size_t n);
+
+    /** \brief adds a record from scanAccounts(), account number is shifted by firstAccount */
+    bool add(const ScanRecord * record, size_t firstAccount = 0);
+    /** \brief derives and adds `accounts[i]/chain/index` for indexes from `start` to `end`
+     *         (see scanAccounts), account number of accounts[i] in entries is firstAccount+i.
+     *         Returns number of added records.
+     */
+    size_t add(const HDPublicKey * accounts, size_t accountsLen, size_t firstAccount,
+               const uint32_t * chains, size_t chainsLen,
+               uint32_t start, uint32_t end, ScriptType type = UNKNOWN_TYPE,
+               unsigned int threads = 0);
+    /** \brief adds all keys of the snapshot (see Snapshot.h) without deriving them again,
+     *         type is the script type of the account (P2SH_P2WPKH adds redeem script hashes).
+     *         Returns number of added keys.
+     */
+    size_t add(const KeySnapshot &snapshot, size_t account, ScriptType type = UNKNOWN_TYPE);
+
+    /** \brief finds an entry by hash160 of a public key, NULL if not found */
+    const ScriptIndexEntry * find(const uint8_t hash[20]) const;
+    /** \brief finds an entry by hash160 of a P2SH redeem script, NULL if not found */
+    const ScriptIndexEntry * findRedeemScript(const uint8_t hash[20]) const;
+    /** \brief finds an entry by P2PKH, P2WPKH or P2SH scriptPubkey without varint.
+     *         P2SH scripts match only redeem scripts of P2SH_P2WPKH accounts,
+     *         P2PKH and P2WPKH scripts match only public key hashes.
+     */
+    const ScriptIndexEntry * find(const uint8_t * script, size_t len) const;
+    const ScriptIndexEntry * find(const Script &scriptPubkey) const;
+    const ScriptIndexEntry * find(const PublicKey &pubkey) const;
+
+    /** \brief finds outputs of the transaction paying to watched scripts.
+     *         matches should have space for tx.outputsNumber pointers,
+     *         NULL for outputs that are not ours. Returns number of matched outputs.
+     */
+    size_t matchOutputs(const Tx &tx, const ScriptIndexEntry ** matches) const;
+    /** \brief finds inputs of the transaction signed by watched keys,
+     *         the public key is taken from the witness (P2WPKH, P2SH_P2WPKH) or scriptSig (P2PKH).
+     *         matches should have space for tx.inputsNumber pointers,
+     *         NULL for inputs that are not ours. Returns number of matched inputs.
+     */
+    size_t matchInputs(const Tx &tx, const ScriptIndexEntry ** matches) const;
+};
+
+#endif // __SCANNER_H__
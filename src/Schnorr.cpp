@@ -0,0 +1,275 @@
+#include "Bitcoin.h"
+#include "Hash.h"
+#include "BitcoinCurve.h"
+
+#include <stdint.h>
+#include <string.h>
+#include "utility/trezor/ecdsa.h"
+#include "utility/trezor/secp256k1.h"
+
+// bip340 Schnorr signatures: https://github.com/bitcoin/bips/blob/master/bip-0340.mediawiki
+
+// ---------------------------------------------------------------- SchnorrSignature class
+
+size_t SchnorrSignature::from_stream(ParseStream *stream){
+    if(status == PARSING_FAILED){
+        return 0;
+    }
+    if(status == PARSING_DONE){
+        bytes_parsed = 0;
+    }
+    status = PARSING_INCOMPLETE;
+    size_t bytes_read = 0;
+    while(stream->available() > 0 && bytes_parsed+bytes_read < 64){
+        size_t cur = bytes_parsed+bytes_read;
+        if(cur < 32){
+            r[cur] = stream->read();
+        }else{
+            s[cur-32] = stream->read();
+        }
+        bytes_read++;
+    }
+    if(bytes_parsed+bytes_read == 64){
+        status = PARSING_DONE;
+    }
+    bytes_parsed += bytes_read;
+    return bytes_read;
+}
+size_t SchnorrSignature::to_stream(SerializeStream *stream, size_t offset) const{
+    size_t bytes_written = 0;
+    while(stream->available() && offset+bytes_written < 64){
+        size_t cur = offset+bytes_written;
+        stream->write((cur < 32) ? r[cur] : s[cur-32]);
+        bytes_written++;
+    }
+    return bytes_written;
+}
+
+// ---------------------------------------------------------------- XOnlyPublicKey class
+
+// finds the point with even y for x (lift_x from bip340)
+static bool liftX(const uint8_t x[32], uint8_t point[64]){
+    bignum256 bx, by;
+    bn_read_be(x, &bx);
+    if(!bn_is_less(&bx, &secp256k1.prime)){
+        return false;
+    }
+    uncompress_coords(&secp256k1, 0, &bx, &by);
+    curve_point p;
+    p.x = bx;
+    p.y = by;
+    // uncompress_coords doesn't check that x is on the curve
+    if(!ecdsa_validate_pubkey(&secp256k1, &p)){
+        return false;
+    }
+    bn_write_be(&bx, point);
+    bn_write_be(&by, point+32);
+    return true;
+}
+
+size_t XOnlyPublicKey::from_stream(ParseStream *stream){
+    if(status == PARSING_FAILED){
+        return 0;
+    }
+    if(status == PARSING_DONE){
+        bytes_parsed = 0;
+    }
+    status = PARSING_INCOMPLETE;
+    size_t bytes_read = 0;
+    while(stream->available() > 0 && bytes_parsed+bytes_read < 32){
+        point[bytes_parsed+bytes_read] = stream->read();
+        bytes_read++;
+    }
+    if(bytes_parsed+bytes_read == 32){
+        compressed = true;
+        status = liftX(point, point) ? PARSING_DONE : PARSING_FAILED;
+        invalidateHash();
+    }
+    bytes_parsed += bytes_read;
+    return bytes_read;
+}
+size_t XOnlyPublicKey::to_stream(SerializeStream *stream, size_t offset) const{
+    size_t bytes_written = 0;
+    while(stream->available() && offset+bytes_written < 32){
+        stream->write(point[offset+bytes_written]);
+        bytes_written++;
+    }
+    return bytes_written;
+}
+XOnlyPublicKey::XOnlyPublicKey(const ECPoint& p){
+    reset();
+    ECPoint even = (p.point[63] & 1) ? -p : p;
+    memcpy(point, even.point, 64);
+}
+XOnlyPublicKey PublicKey::xonly() const{
+    return XOnlyPublicKey(*this);
+}
+
+// e = tagged_hash("BIP0340/challenge", r || pubkey.x || msg) mod n
+static ECScalar challenge(const uint8_t r[32], const uint8_t px[32], const uint8_t msg[32]){
+    uint8_t h[32];
+    TaggedHash th(TAG_BIP340_CHALLENGE);
+    th.write(r, 32);
+    th.write(px, 32);
+    th.write(msg, 32);
+    th.end(h);
+    return ECScalar(h, 32);
+}
+
+// checks r < p and s < n, reads R with even y
+static bool readSignature(const SchnorrSignature& sig, ECPoint * R, ECScalar * s, uint8_t r[32]){
+    uint8_t arr[64];
+    sig.bin(arr);
+    memcpy(r, arr, 32);
+    bignum256 bs;
+    bn_read_be(arr+32, &bs);
+    if(!bn_is_less(&bs, &secp256k1.order)){
+        return false;
+    }
+    s->setSecret(arr+32);
+    R->reset();
+    return liftX(r, R->point);
+}
+
+bool XOnlyPublicKey::verify(const SchnorrSignature& sig, const uint8_t msg[32]) const{
+    if(!isValid()){
+        return false;
+    }
+    uint8_t arr[64];
+    sig.bin(arr);
+    bignum256 b;
+    bn_read_be(arr, &b);
+    if(!bn_is_less(&b, &secp256k1.prime)){
+        return false;
+    }
+    bn_read_be(arr+32, &b);
+    if(!bn_is_less(&b, &secp256k1.order)){
+        return false;
+    }
+    ECScalar s;
+    s.setSecret(arr+32);
+    ECScalar e = challenge(arr, point, msg);
+    // R = s*G - e*P
+    ECJacobianPoint R = -(e * ECJacobianPoint(*this));
+    if(s.isValid()){
+        R += s * ECJacobianPoint(GeneratorPoint);
+    }
+    if(R.isInfinity()){
+        return false;
+    }
+    ECPoint Ra = R.affine();
+    return ((Ra.point[63] & 1) == 0) && (memcmp(Ra.point, arr, 32) == 0);
+}
+
+bool schnorrVerifyBatch(const SchnorrSignature * sigs, const XOnlyPublicKey * pubkeys, const uint8_t * msgs, size_t n){
+    if(n == 0){
+        return true;
+    }
+    // s[i] * G = R[i] + e[i] * P[i] for every i are combined with random weights a[i]:
+    // (sum a[i]*s[i]) * G = sum a[i] * R[i] + sum (a[i]*e[i]) * P[i]
+    ECScalar * scalars = new ECScalar[2*n];
+    ECPoint * points = new ECPoint[2*n];
+    if(scalars == NULL || points == NULL){
+        delete[] scalars;
+        delete[] points;
+        return false;
+    }
+    bool ok = true;
+    // weights are derived from all inputs, so they can't be predicted by the signer
+    uint8_t seed[32];
+    TaggedHash th("BIP0340/batch");
+    for(size_t i=0; i<n; i++){
+        uint8_t arr[64];
+        sigs[i].bin(arr);
+        th.write(arr, 64);
+        th.write(pubkeys[i].point, 32);
+        th.write(msgs+32*i, 32);
+    }
+    th.end(seed);
+
+    ECScalar sum;
+    for(size_t i=0; i<n && ok; i++){
+        uint8_t r[32];
+        ECScalar s;
+        if(!pubkeys[i].isValid() || !readSignature(sigs[i], &points[2*i], &s, r)){
+            ok = false;
+            break;
+        }
+        points[2*i+1] = pubkeys[i];
+        ECScalar e = challenge(r, pubkeys[i].point, msgs+32*i);
+        // a[0] = 1, other weights are 128-bit random numbers
+        ECScalar a(1);
+        if(i > 0){
+            uint8_t buf[36];
+            memcpy(buf, seed, 32);
+            intToLittleEndian(i, buf+32, 4);
+            uint8_t h[32];
+            sha256(buf, sizeof(buf), h);
+            memset(h, 0, 16);
+            a = ECScalar(h, 32);
+        }
+        scalars[2*i] = a;
+        scalars[2*i+1] = a * e;
+        sum += a * s;
+    }
+    if(ok){
+        ECJacobianPoint rhs;
+        if(multiScalarMultiply(scalars, points, 2*n, &rhs) == 0){
+            ok = false;
+        }else{
+            ECJacobianPoint lhs;
+            if(sum.isValid()){
+                lhs = sum * ECJacobianPoint(GeneratorPoint);
+            }
+            ok = (lhs == rhs);
+        }
+    }
+    delete[] scalars;
+    delete[] points;
+    return ok;
+}
+
+// ---------------------------------------------------------------- PrivateKey signing
+
+SchnorrSignature PrivateKey::schnorrSign(const uint8_t msg[32], const uint8_t aux[32]) const{
+    if(!isValid()){
+        return SchnorrSignature();
+    }
+    computePublicKey();
+    ECScalar d = *this;
+    if(pubKey.point[63] & 1){ // key with even y
+        d = -d;
+    }
+    uint8_t zero[32] = { 0 };
+    uint8_t t[32];
+    uint8_t secret[32];
+    uint8_t rand[32];
+    // t = d xor tagged_hash("BIP0340/aux", aux)
+    taggedHash(TAG_BIP340_AUX, (aux == NULL) ? zero : aux, 32, t);
+    d.getSecret(secret);
+    for(int i=0; i<32; i++){
+        t[i] ^= secret[i];
+    }
+    // k = tagged_hash("BIP0340/nonce", t || pubkey.x || msg) mod n
+    TaggedHash th(TAG_BIP340_NONCE);
+    th.write(t, 32);
+    th.write(pubKey.point, 32);
+    th.write(msg, 32);
+    th.end(rand);
+    ECScalar k(rand, 32);
+    memset(t, 0, 32);
+    memset(secret, 0, 32);
+    memset(rand, 0, 32);
+    if(!k.isValid()){
+        return SchnorrSignature();
+    }
+    ECPoint R = k * GeneratorPoint;
+    if(R.point[63] & 1){ // nonce with even y
+        k = -k;
+    }
+    ECScalar e = challenge(R.point, pubKey.point, msg);
+    ECScalar s = k + e * d;
+    uint8_t sarr[32];
+    s.getSecret(sarr);
+    return SchnorrSignature(R.point, sarr);
+}
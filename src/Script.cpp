@@ -16,7 +16,7 @@ Script::Script(void){
     init();
 }
 Script::Script(const uint8_t * buffer, size_t len){
-    reset();
+    init();
     push(buffer, len);
 }
 void Script::fromAddress(const char * address){
@@ -88,7 +88,7 @@ void Script::fromAddress(const char * address){
         }
     }
 }
-Script::Script(const PublicKey pubkey, ScriptType type){
+Script::Script(const PublicKey &pubkey, ScriptType type){
     reset();
     if(type == P2PKH){
         scriptLen = 25;
@@ -96,9 +96,7 @@ Script::Script(const PublicKey pubkey, ScriptType type){
         scriptArray[0] = OP_DUP;
         scriptArray[1] = OP_HASH160;
         scriptArray[2] = 20;
-        uint8_t sec_arr[65] = { 0 };
-        int l = pubkey.sec(sec_arr, sizeof(sec_arr));
-        hash160(sec_arr, l, scriptArray+3);
+        pubkey.keyHash(scriptArray+3);
         scriptArray[23] = OP_EQUALVERIFY;
         scriptArray[24] = OP_CHECKSIG;
     }
@@ -107,9 +105,7 @@ Script::Script(const PublicKey pubkey, ScriptType type){
         scriptArray = (uint8_t *) calloc( scriptLen, sizeof(uint8_t));
         scriptArray[0] = 0x00;
         scriptArray[1] = 20;
-        uint8_t sec_arr[65] = { 0 };
-        int l = pubkey.sec(sec_arr, sizeof(sec_arr));
-        hash160(sec_arr, l, scriptArray+2);
+        pubkey.keyHash(scriptArray+2);
     }
 }
 Script::Script(const Script &other, ScriptType type){
@@ -292,14 +288,21 @@ std::string Script::address(const Network * network) const{
     char buffer[100] = { 0 };
     size_t l = address(buffer, sizeof(buffer), network);
     if(l == 0){
-        return string("");
+        return std::string("");
     }
-    return string(buffer);
+    return std::string(buffer);
 }
 #endif
 size_t Script::length() const{
     return scriptLen + lenVarInt(scriptLen);
 }
+size_t Script::serializeScript(uint8_t * array, size_t len) const{
+    if(len < scriptLen){
+        return 0;
+    }
+    memcpy(array, scriptArray, scriptLen);
+    return scriptLen;
+}
 size_t Script::push(uint8_t code){
     if(scriptLen+1 > MAX_SCRIPT_SIZE){
         clear();
@@ -329,7 +332,7 @@ size_t Script::push(const uint8_t * data, size_t len){
     scriptLen += len;
     return scriptLen;
 }
-size_t Script::push(const PublicKey pubkey){
+size_t Script::push(const PublicKey &pubkey){
     uint8_t sec[65];
     uint8_t len = pubkey.sec(sec, sizeof(sec));
     push(len);
@@ -356,6 +359,13 @@ Script Script::scriptPubkey(ScriptType type) const{
     Script sc(*this, type);
     return sc;
 }
+int Script::tapLeafHash(uint8_t hash[32], uint8_t leafVersion) const{
+    // tagged_hash("TapLeaf", leaf_version || compact_size(script) || script)
+    TaggedHash th(TAG_TAP_LEAF);
+    th.write(leafVersion);
+    th.serialize(this, 0);
+    return th.end(hash);
+}
 Script &Script::operator=(const Script &other){
     reset();
     clear();
@@ -401,7 +411,7 @@ Witness::Witness(const uint8_t * buffer, size_t len){
     ParseByteStream s(buffer, len);
     Witness::from_stream(&s);
 }
-Witness::Witness(const Signature sig, const PublicKey pubkey){
+Witness::Witness(const Signature sig, const PublicKey &pubkey){
     numElements = 0;
     witnessLen = 0;
     reset();
@@ -522,6 +532,25 @@ size_t Witness::to_stream(SerializeStream *s, size_t offset) const{
 size_t Witness::length() const{
     return witnessLen + lenVarInt(numElements);
 }
+size_t Witness::element(uint8_t index, uint8_t * data, size_t len) const{
+    size_t cur = 0;
+    for(uint32_t i = 0; i < numElements && cur < witnessLen; i++){
+        size_t l = readVarInt(witnessArray+cur, witnessLen-cur);
+        cur += lenVarInt(l);
+        if(cur + l > witnessLen){
+            return 0;
+        }
+        if(i == index){
+            if(l > len){
+                return 0;
+            }
+            memcpy(data, witnessArray+cur, l);
+            return l;
+        }
+        cur += l;
+    }
+    return 0;
+}
 size_t Witness::push(const uint8_t * data, size_t len){
     if(witnessLen + len + lenVarInt(len) > MAX_SCRIPT_SIZE){
         clear();
@@ -538,7 +567,7 @@ size_t Witness::push(const uint8_t * data, size_t len){
     numElements++;
     return witnessLen;
 }
-size_t Witness::push(const PublicKey pubkey){
+size_t Witness::push(const PublicKey &pubkey){
     uint8_t sec[65];
     uint8_t len = pubkey.sec(sec, sizeof(sec));
     push(sec, len);
@@ -0,0 +1,185 @@
+#include "Snapshot.h"
+#include "Scanner.h"
+#include "Hash.h"
+#include "Conversion.h"
+
+#include <stdint.h>
+#include <string.h>
+
+static const uint8_t snapshotMagic[4] = { 'u', 'B', 'K', 'S' };
+
+#define SNAPSHOT_CHECKSUM_OFFSET 8
+#define SNAPSHOT_CHAIN_OFFSET    40
+#define SNAPSHOT_START_OFFSET    44
+#define SNAPSHOT_COUNT_OFFSET    48
+#define SNAPSHOT_XPUB_OFFSET     52
+
+static uint64_t snapshotLength(uint64_t count, uint8_t contents){
+    uint64_t len = SNAPSHOT_HEADER_SIZE;
+    if(contents & SNAPSHOT_PUBKEYS){
+        len += 33 * count;
+    }
+    if(contents & SNAPSHOT_HASHES){
+        len += 20 * count;
+    }
+    return len;
+}
+size_t keySnapshotLength(uint32_t count, uint8_t contents){
+    uint64_t len = snapshotLength(count, contents);
+    if(len > (size_t)-1){
+        return 0;
+    }
+    return (size_t)len;
+}
+
+// sha256 of the snapshot with zero checksum field
+static void snapshotChecksum(const uint8_t * snapshot, size_t len, uint8_t hash[32]){
+    uint8_t zero[32] = { 0 };
+    SHA256 h;
+    h.write(snapshot, SNAPSHOT_CHECKSUM_OFFSET);
+    h.write(zero, sizeof(zero));
+    h.write(snapshot + SNAPSHOT_CHECKSUM_OFFSET + 32, len - SNAPSHOT_CHECKSUM_OFFSET - 32);
+    h.end(hash);
+}
+
+typedef struct{
+    uint8_t * pubkeys;
+    uint8_t * hashes;
+    uint32_t start;
+    size_t written;
+} SnapshotSink;
+
+// records come in order of indexes, but position is taken from the index anyway
+static void writeRecord(const ScanRecord * record, void * ctx){
+    SnapshotSink * s = (SnapshotSink *)ctx;
+    size_t i = record->index - s->start;
+    if(s->pubkeys != NULL){
+        memcpy(s->pubkeys + 33*i, record->pubkey, 33);
+    }
+    if(s->hashes != NULL){
+        memcpy(s->hashes + 20*i, record->keyHash, 20);
+    }
+    s->written++;
+}
+
+size_t writeKeySnapshot(const HDPublicKey &account, uint32_t chain, uint32_t start, uint32_t end,
+                        uint8_t * out, size_t len, uint8_t contents, unsigned int threads){
+    if(end <= start || end > 0x80000000 || chain >= 0x80000000){
+        return 0;
+    }
+    contents &= (SNAPSHOT_PUBKEYS | SNAPSHOT_HASHES);
+    uint32_t count = end - start;
+    size_t total = keySnapshotLength(count, contents);
+    if(total == 0 || total > len || contents == 0){
+        return 0;
+    }
+    memset(out, 0, SNAPSHOT_HEADER_SIZE);
+    memcpy(out, snapshotMagic, sizeof(snapshotMagic));
+    out[4] = SNAPSHOT_VERSION;
+    out[5] = contents;
+    intToLittleEndian(chain, out + SNAPSHOT_CHAIN_OFFSET, 4);
+    intToLittleEndian(start, out + SNAPSHOT_START_OFFSET, 4);
+    intToLittleEndian(count, out + SNAPSHOT_COUNT_OFFSET, 4);
+    if(account.serialize(out + SNAPSHOT_XPUB_OFFSET, 78) != 78){
+        return 0;
+    }
+
+    SnapshotSink s;
+    uint8_t * body = out + SNAPSHOT_HEADER_SIZE;
+    s.pubkeys = (contents & SNAPSHOT_PUBKEYS) ? body : NULL;
+    s.hashes = (contents & SNAPSHOT_HASHES) ? (body + ((s.pubkeys != NULL) ? 33*(size_t)count : 0)) : NULL;
+    s.start = start;
+    s.written = 0;
+    scanAccounts(&account, 1, &chain, 1, start, end, P2WPKH, writeRecord, &s, threads);
+    if(s.written != count){
+        return 0;
+    }
+    snapshotChecksum(out, total, out + SNAPSHOT_CHECKSUM_OFFSET);
+    return total;
+}
+
+// ---------------------------------------------------------------- KeySnapshot class
+
+KeySnapshot::KeySnapshot(){
+    data = NULL;
+    dataLen = 0;
+}
+KeySnapshot::KeySnapshot(const uint8_t * snapshot, size_t len){
+    load(snapshot, len);
+}
+bool KeySnapshot::load(const uint8_t * snapshot, size_t len){
+    data = NULL;
+    dataLen = 0;
+    if(snapshot == NULL || len < SNAPSHOT_HEADER_SIZE){
+        return false;
+    }
+    if(memcmp(snapshot, snapshotMagic, sizeof(snapshotMagic)) != 0 || snapshot[4] != SNAPSHOT_VERSION){
+        return false;
+    }
+    uint8_t c = snapshot[5];
+    if(c == 0 || (c & ~(SNAPSHOT_PUBKEYS | SNAPSHOT_HASHES)) != 0){
+        return false;
+    }
+    uint32_t start = littleEndianToInt(snapshot + SNAPSHOT_START_OFFSET, 4);
+    uint32_t count = littleEndianToInt(snapshot + SNAPSHOT_COUNT_OFFSET, 4);
+    if((uint64_t)start + count > 0x80000000){
+        return false;
+    }
+    uint64_t total = snapshotLength(count, c);
+    if(total > len){
+        return false;
+    }
+    data = snapshot;
+    dataLen = (size_t)total;
+    return true;
+}
+bool KeySnapshot::verify() const{
+    if(!isValid()){
+        return false;
+    }
+    uint8_t hash[32];
+    snapshotChecksum(data, dataLen, hash);
+    return (memcmp(hash, data + SNAPSHOT_CHECKSUM_OFFSET, 32) == 0);
+}
+size_t KeySnapshot::length() const{
+    return dataLen;
+}
+uint8_t KeySnapshot::contents() const{
+    return isValid() ? data[5] : 0;
+}
+uint32_t KeySnapshot::chain() const{
+    return isValid() ? littleEndianToInt(data + SNAPSHOT_CHAIN_OFFSET, 4) : 0;
+}
+uint32_t KeySnapshot::start() const{
+    return isValid() ? littleEndianToInt(data + SNAPSHOT_START_OFFSET, 4) : 0;
+}
+uint32_t KeySnapshot::count() const{
+    return isValid() ? littleEndianToInt(data + SNAPSHOT_COUNT_OFFSET, 4) : 0;
+}
+HDPublicKey KeySnapshot::account() const{
+    HDPublicKey pub;
+    if(isValid()){
+        pub.parse(data + SNAPSHOT_XPUB_OFFSET, 78);
+    }
+    return pub;
+}
+const uint8_t * KeySnapshot::pubkey(uint32_t index) const{
+    if(!(contents() & SNAPSHOT_PUBKEYS) || index < start() || index - start() >= count()){
+        return NULL;
+    }
+    return data + SNAPSHOT_HEADER_SIZE + 33 * (size_t)(index - start());
+}
+const uint8_t * KeySnapshot::keyHash(uint32_t index) const{
+    if(!(contents() & SNAPSHOT_HASHES) || index < start() || index - start() >= count()){
+        return NULL;
+    }
+    size_t offset = (contents() & SNAPSHOT_PUBKEYS) ? 33 * (size_t)count() : 0;
+    return data + SNAPSHOT_HEADER_SIZE + offset + 20 * (size_t)(index - start());
+}
+PublicKey KeySnapshot::publicKey(uint32_t index) const{
+    const uint8_t * sec = pubkey(index);
+    if(sec == NULL){
+        return PublicKey();
+    }
+    return PublicKey(sec);
+}
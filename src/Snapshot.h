@@ -0,0 +1,89 @@
+#ifndef __SNAPSHOT_H__
+#define __SNAPSHOT_H__
+
+#include "Bitcoin.h"
+
+/*
+ * Snapshot of derived keys of one chain of an account: account/chain/start...account/chain/start+count-1
+ * Can be stored in a file and used directly from memory (i.e. mmap), all fields are at fixed offsets:
+ *
+ *   offset  size      field
+ *   0       4         magic "uBKS"
+ *   4       1         version (1)
+ *   5       1         contents (SNAPSHOT_PUBKEYS and / or SNAPSHOT_HASHES)
+ *   6       2         reserved, zero
+ *   8       32        sha256 of the snapshot with this field set to zeroes
+ *   40      4         chain, little endian
+ *   44      4         start index, little endian
+ *   48      4         count, little endian
+ *   52      78        account xpub (bip32 serialization)
+ *   130     6         reserved, zero
+ *   136     33*count  compressed public keys (if SNAPSHOT_PUBKEYS is set)
+ *   ...     20*count  hash160 of the public keys (if SNAPSHOT_HASHES is set)
+ *
+ * Several snapshots can be stored one after another, KeySnapshot::length() gives the offset of the next one.
+ */
+
+#define SNAPSHOT_HEADER_SIZE 136
+#define SNAPSHOT_VERSION     1
+
+/** \brief Data stored in the snapshot, can be combined */
+enum SnapshotContents{
+    SNAPSHOT_PUBKEYS = 1,
+    SNAPSHOT_HASHES = 2
+};
+
+/** \brief Returns length of the snapshot with count keys */
+size_t keySnapshotLength(uint32_t count, uint8_t contents = SNAPSHOT_PUBKEYS | SNAPSHOT_HASHES);
+
+/** \brief Derives keys `account/chain/index` for indexes from `start` to `end` (not including `end`)
+ *         and writes the snapshot to the array. Derivation runs in `threads` threads
+ *         with USE_STD_THREAD (0 - one per CPU core), see scanAccounts.
+ *         Returns number of bytes written, 0 if the array is too small or the range is invalid.
+ */
+size_t writeKeySnapshot(const HDPublicKey &account, uint32_t chain, uint32_t start, uint32_t end,
+                        uint8_t * out, size_t len,
+                        uint8_t contents = SNAPSHOT_PUBKEYS | SNAPSHOT_HASHES,
+                        unsigned int threads = 0);
+
+/**
+ *  \brief Read-only view of a snapshot in memory. Doesn't copy the data,
+ *         so the memory should stay valid while the view is used.
+ */
+class KeySnapshot{
+protected:
+    const uint8_t * data;
+    size_t dataLen;
+public:
+    KeySnapshot();
+    /** \brief same as load() */
+    KeySnapshot(const uint8_t * snapshot, size_t len);
+    /** \brief checks the header and that all keys fit in `len` bytes, the checksum is not checked */
+    bool load(const uint8_t * snapshot, size_t len);
+    /** \brief checks the checksum of the snapshot */
+    bool verify() const;
+    bool isValid() const{ return (data != NULL); };
+    explicit operator bool() const{ return isValid(); };
+
+    /** \brief length of the snapshot in bytes */
+    size_t length() const;
+    uint8_t contents() const;
+    uint32_t chain() const;
+    /** \brief index of the first key */
+    uint32_t start() const;
+    /** \brief number of keys */
+    uint32_t count() const;
+    /** \brief xpub of the account */
+    HDPublicKey account() const;
+
+    /** \brief returns pointer to the 33-byte compressed public key with the index,
+     *         NULL if it's out of range or public keys are not stored */
+    const uint8_t * pubkey(uint32_t index) const;
+    /** \brief returns pointer to the 20-byte hash160 of the public key with the index,
+     *         NULL if it's out of range or hashes are not stored */
+    const uint8_t * keyHash(uint32_t index) const;
+    /** \brief returns the public key with the index, invalid key if it's not available */
+    PublicKey publicKey(uint32_t index) const;
+};
+
+#endif // __SNAPSHOT_H__
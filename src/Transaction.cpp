@@ -686,6 +686,99 @@ int Tx::sigHashSegwit(uint8_t h[32], uint8_t inputIndex, const Script scriptPubK
     return 32;
 }
 
+int Tx::precomputeTaproot(TaprootSigHashCache * cache, const TxOut * spentOutputs) const{
+    // bip341 uses single sha256 here
+    SHA256 prevouts, amounts, scripts, sequences, outputs;
+    uint8_t arr[8];
+    for(size_t i=0; i<inputsNumber; i++){
+        prevouts.write(txIns[i].hash, 32);
+        intToLittleEndian(txIns[i].outputIndex, arr, 4);
+        prevouts.write(arr, 4);
+        intToLittleEndian(spentOutputs[i].amount, arr, 8);
+        amounts.write(arr, 8);
+        scripts.serialize(&spentOutputs[i].scriptPubkey, 0);
+        intToLittleEndian(txIns[i].sequence, arr, 4);
+        sequences.write(arr, 4);
+    }
+    for(size_t i=0; i<outputsNumber; i++){
+        outputs.serialize(&txOuts[i], 0);
+    }
+    prevouts.end(cache->shaPrevouts);
+    amounts.end(cache->shaAmounts);
+    scripts.end(cache->shaScriptPubkeys);
+    sequences.end(cache->shaSequences);
+    outputs.end(cache->shaOutputs);
+    return 32*5;
+}
+
+int Tx::sigHashTaproot(uint8_t h[32], size_t inputIndex, const TaprootSigHashCache * cache, const TxOut * spentOutputs,
+                       uint8_t sighash, const uint8_t * leafHash, uint32_t codesepPos,
+                       const uint8_t * annex, size_t annexLen) const{
+    uint8_t outputType = (sighash == SIGHASH_DEFAULT) ? SIGHASH_ALL : (sighash & 0x03);
+    bool anyoneCanPay = ((sighash & SIGHASH_ANYONECANPAY) != 0);
+    if((sighash & 0x7C) != 0 || (sighash != SIGHASH_DEFAULT && outputType == 0)){
+        return 0;
+    }
+    if(inputIndex >= inputsNumber || (outputType == SIGHASH_SINGLE && inputIndex >= outputsNumber)){
+        return 0;
+    }
+    TaggedHash s(TAG_TAP_SIGHASH);
+    uint8_t arr[10];
+    s.write(0x00); // epoch
+    s.write(sighash);
+    intToLittleEndian(version, arr, 4);
+    s.write(arr, 4);
+    intToLittleEndian(locktime, arr, 4);
+    s.write(arr, 4);
+    if(!anyoneCanPay){
+        s.write(cache->shaPrevouts, 32);
+        s.write(cache->shaAmounts, 32);
+        s.write(cache->shaScriptPubkeys, 32);
+        s.write(cache->shaSequences, 32);
+    }
+    if(outputType == SIGHASH_ALL){
+        s.write(cache->shaOutputs, 32);
+    }
+    uint8_t spendType = ((leafHash != NULL) ? 2 : 0) + ((annex != NULL) ? 1 : 0);
+    s.write(spendType);
+    if(anyoneCanPay){
+        const TxIn * txIn = &txIns[inputIndex];
+        s.write(txIn->hash, 32);
+        intToLittleEndian(txIn->outputIndex, arr, 4);
+        s.write(arr, 4);
+        intToLittleEndian(spentOutputs[inputIndex].amount, arr, 8);
+        s.write(arr, 8);
+        s.serialize(&spentOutputs[inputIndex].scriptPubkey, 0);
+        intToLittleEndian(txIn->sequence, arr, 4);
+        s.write(arr, 4);
+    }else{
+        intToLittleEndian(inputIndex, arr, 4);
+        s.write(arr, 4);
+    }
+    if(annex != NULL){
+        SHA256 sa;
+        size_t l = writeVarInt(annexLen, arr, 10);
+        sa.write(arr, l);
+        sa.write(annex, annexLen);
+        sa.end(h);
+        s.write(h, 32);
+    }
+    if(outputType == SIGHASH_SINGLE){
+        SHA256 so;
+        so.serialize(&txOuts[inputIndex], 0);
+        so.end(h);
+        s.write(h, 32);
+    }
+    if(leafHash != NULL){
+        s.write(leafHash, 32);
+        s.write(0x00); // key_version
+        intToLittleEndian(codesepPos, arr, 4);
+        s.write(arr, 4);
+    }
+    s.end(h);
+    return 32;
+}
+
 Signature Tx::signInput(uint8_t inputIndex, const PrivateKey pk, const Script redeemScript, SigHashType sighash){
     uint8_t h[32];
     sigHash(h, inputIndex, redeemScript, sighash);
@@ -33,6 +33,25 @@
 #define USE_MBED_STREAM    1 /* Mbed Stream class */
 #endif
 
+/* Spread batch operations (e.g. mnemonicToSeeds) across CPU cores
+ * with std::thread. Makes sense only on hosts, define it to 1 there.
+ */
+#ifndef USE_STD_THREAD
+#define USE_STD_THREAD 0
+#endif
+
+/* Number of custom tags that can be registered
+ * with TaggedHash::registerTag() to reuse their midstates
+ */
+#ifndef TAGGED_HASH_CUSTOM_TAGS
+#define TAGGED_HASH_CUSTOM_TAGS 8
+#endif
+
+/* Maximum number of indexes in DerivationPath */
+#ifndef DERIVATION_PATH_MAX_DEPTH
+#define DERIVATION_PATH_MAX_DEPTH 16
+#endif
+
 #if USE_STD_STRING
 #include <string>
 // using std::string;
@@ -867,6 +867,41 @@ void bn_inverse(bignum256 *x, const bignum256 *prime)
 }
 #endif
 
+// Montgomery's trick: replaces every x[i] with x[i]^-1 using a single
+// bn_inverse and 3(n-1) multiplications.
+// scratch must have space for n numbers, it is wiped on exit.
+// none of x[i] can be 0 mod prime.
+// the results are fully reduced
+void bn_inverse_batch(bignum256 *x, size_t n, const bignum256 *prime, bignum256 *scratch)
+{
+	bignum256 inv, tmp;
+	size_t i;
+	if (n == 0) {
+		return;
+	}
+	// scratch[i] = x[0] * x[1] * ... * x[i]
+	scratch[0] = x[0];
+	for (i = 1; i < n; i++) {
+		scratch[i] = x[i];
+		bn_multiply(&scratch[i-1], &scratch[i], prime);
+	}
+	inv = scratch[n-1];
+	bn_inverse(&inv, prime);
+	// inv = (x[0] * ... * x[i])^-1
+	for (i = n-1; i > 0; i--) {
+		tmp = inv;
+		bn_multiply(&scratch[i-1], &tmp, prime); // tmp = x[i]^-1
+		bn_multiply(&x[i], &inv, prime);         // inv = (x[0] * ... * x[i-1])^-1
+		bn_mod(&tmp, prime);
+		x[i] = tmp;
+	}
+	bn_mod(&inv, prime);
+	x[0] = inv;
+	memzero(&inv, sizeof(inv));
+	memzero(&tmp, sizeof(tmp));
+	memzero(scratch, n * sizeof(bignum256));
+}
+
 void bn_normalize(bignum256 *a) {
 	bn_addi(a, 0);
 }
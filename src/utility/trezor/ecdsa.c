@@ -187,10 +187,6 @@ void conditional_negate(uint32_t cond, bignum256 *a, const bignum256 *prime)
 	assert(a->val[8] < 0x20000);
 }
 
-typedef struct jacobian_curve_point {
-	bignum256 x, y, z;
-} jacobian_curve_point;
-
 // generate random K for signing/side-channel noise
 static void generate_k_random(bignum256 *k, const bignum256 *prime) {
 	do {
@@ -422,8 +418,150 @@ void point_jacobian_double(jacobian_curve_point *p, const ecdsa_curve *curve) {
 	bn_fast_mod(&p->y, prime);
 }
 
+// set jp = p with z = 1, point at infinity gets z = 0
+void point_jacobian_set_affine(const curve_point *p, jacobian_curve_point *jp)
+{
+	if (point_is_infinity(p)) {
+		point_jacobian_set_infinity(jp);
+		return;
+	}
+	jp->x = p->x;
+	jp->y = p->y;
+	bn_one(&jp->z);
+}
+
+void point_jacobian_set_infinity(jacobian_curve_point *p)
+{
+	bn_one(&p->x);
+	bn_one(&p->y);
+	bn_zero(&p->z);
+}
+
+// return true iff z = 0 (mod prime)
+int point_jacobian_is_infinity(const jacobian_curve_point *p, const bignum256 *prime)
+{
+	bignum256 z = p->z;
+	bn_fast_mod(&z, prime);
+	bn_mod(&z, prime);
+	return bn_is_zero(&z);
+}
+
+// p = -p
+void point_jacobian_negate(jacobian_curve_point *p, const bignum256 *prime)
+{
+	bn_fast_mod(&p->y, prime);
+	conditional_negate(0xffffffff, &p->y, prime);
+	bn_fast_mod(&p->y, prime);
+}
+
+// p2 = p1 + p2, both points in jacobian coordinates.
+// Unlike point_jacobian_add handles all special cases:
+// point at infinity, p1 = p2 and p1 = -p2.
+// The timing depends on the points, don't use it with secret points.
+void point_jacobian_add_jacobian(const jacobian_curve_point *p1, jacobian_curve_point *p2, const ecdsa_curve *curve)
+{
+	bignum256 z1z1, z2z2, u1, u2, s1, s2, h, r, hh, hhh, v;
+	const bignum256 *prime = &curve->prime;
+
+	if (point_jacobian_is_infinity(p1, prime)) {
+		return;
+	}
+	if (point_jacobian_is_infinity(p2, prime)) {
+		*p2 = *p1;
+		return;
+	}
+
+	/* u1 = x1 * z2^2, u2 = x2 * z1^2
+	 * s1 = y1 * z2^3, s2 = y2 * z1^3
+	 * h = u2 - u1, r = s2 - s1
+	 * x3 = r^2 - h^3 - 2 u1 h^2
+	 * y3 = r (u1 h^2 - x3) - s1 h^3
+	 * z3 = h z1 z2
+	 */
+	z1z1 = p1->z;
+	bn_multiply(&z1z1, &z1z1, prime);
+	z2z2 = p2->z;
+	bn_multiply(&z2z2, &z2z2, prime);
+	u1 = p1->x;
+	bn_multiply(&z2z2, &u1, prime);
+	u2 = p2->x;
+	bn_multiply(&z1z1, &u2, prime);
+	s1 = p1->y;
+	bn_multiply(&p2->z, &s1, prime);
+	bn_multiply(&z2z2, &s1, prime);
+	s2 = p2->y;
+	bn_multiply(&p1->z, &s2, prime);
+	bn_multiply(&z1z1, &s2, prime);
+
+	bn_subtractmod(&u2, &u1, &h, prime);
+	bn_fast_mod(&h, prime);
+	bn_mod(&h, prime);
+	bn_subtractmod(&s2, &s1, &r, prime);
+	bn_fast_mod(&r, prime);
+	bn_mod(&r, prime);
+
+	if (bn_is_zero(&h)) {
+		if (bn_is_zero(&r)) {
+			// p1 = p2
+			*p2 = *p1;
+			point_jacobian_double(p2, curve);
+		} else {
+			// p1 = -p2
+			point_jacobian_set_infinity(p2);
+		}
+		return;
+	}
+
+	hh = h;
+	bn_multiply(&hh, &hh, prime);
+	hhh = h;
+	bn_multiply(&hh, &hhh, prime);
+	v = u1;
+	bn_multiply(&hh, &v, prime);
+
+	// z3 = h z1 z2
+	bn_multiply(&p1->z, &p2->z, prime);
+	bn_multiply(&h, &p2->z, prime);
+
+	// x3 = r^2 - h^3 - 2v
+	p2->x = r;
+	bn_multiply(&p2->x, &p2->x, prime);
+	bn_subtractmod(&p2->x, &hhh, &p2->x, prime);
+	bn_fast_mod(&p2->x, prime);
+	bn_subtractmod(&p2->x, &v, &p2->x, prime);
+	bn_fast_mod(&p2->x, prime);
+	bn_subtractmod(&p2->x, &v, &p2->x, prime);
+	bn_fast_mod(&p2->x, prime);
+
+	// y3 = r (v - x3) - s1 h^3
+	bn_subtractmod(&v, &p2->x, &p2->y, prime);
+	bn_multiply(&r, &p2->y, prime);
+	bn_multiply(&s1, &hhh, prime);
+	bn_subtractmod(&p2->y, &hhh, &p2->y, prime);
+	bn_fast_mod(&p2->y, prime);
+}
+
+// same as jacobian_to_curve, but handles point at infinity
+void point_jacobian_normalize(const jacobian_curve_point *jp, curve_point *p, const bignum256 *prime)
+{
+	if (point_jacobian_is_infinity(jp, prime)) {
+		point_set_infinity(p);
+		return;
+	}
+	jacobian_to_curve(jp, p, prime);
+}
+
 // res = k * p
 void point_multiply(const ecdsa_curve *curve, const bignum256 *k, const curve_point *p, curve_point *res)
+{
+	CONFIDENTIAL jacobian_curve_point jres;
+	point_multiply_jacobian(curve, k, p, &jres);
+	point_jacobian_normalize(&jres, res, &curve->prime);
+	memzero(&jres, sizeof(jres));
+}
+
+// res = k * p, result is left in jacobian coordinates
+void point_multiply_jacobian(const ecdsa_curve *curve, const bignum256 *k, const curve_point *p, jacobian_curve_point *res)
 {
 	// this algorithm is loosely based on
 	//  Katsuyuki Okeya and Tsuyoshi Takagi, The Width-w NAF Method Provides
@@ -432,13 +570,12 @@ void point_multiply(const ecdsa_curve *curve, const bignum256 *k, const curve_po
 	assert (bn_is_less(k, &curve->order));
 
 	int i, j;
-	static CONFIDENTIAL bignum256 a;
+	CONFIDENTIAL bignum256 a;
 	uint32_t *aptr;
 	uint32_t abits;
 	int ashift;
 	uint32_t is_even = (k->val[0] & 1) - 1;
 	uint32_t bits, sign, nsign;
-	static CONFIDENTIAL jacobian_curve_point jres;
 	curve_point pmult[8];
 	const bignum256 *prime = &curve->prime;
 
@@ -460,7 +597,7 @@ void point_multiply(const ecdsa_curve *curve, const bignum256 *k, const curve_po
 
 	// special case 0*p:  just return zero. We don't care about constant time.
 	if (!is_non_zero) {
-		point_set_infinity(res);
+		point_jacobian_set_infinity(res);
 		return;
 	}
 
@@ -502,16 +639,16 @@ void point_multiply(const ecdsa_curve *curve, const bignum256 *k, const curve_po
 	sign = (bits >> 4) - 1;
 	bits ^= sign;
 	bits &= 15;
-	curve_to_jacobian(&pmult[bits>>1], &jres, prime);
+	curve_to_jacobian(&pmult[bits>>1], res, prime);
 	for (i = 62; i >= 0; i--) {
 		// sign = sign(a[i+1])  (0xffffffff for negative, 0 for positive)
 		// invariant jres = (-1)^sign sum_{j=i+1..63} (a[j] * 16^{j-i-1} * p)
 		// abits >> (ashift - 4) = lowbits(a >> (i*4))
 
-		point_jacobian_double(&jres, curve);
-		point_jacobian_double(&jres, curve);
-		point_jacobian_double(&jres, curve);
-		point_jacobian_double(&jres, curve);
+		point_jacobian_double(res, curve);
+		point_jacobian_double(res, curve);
+		point_jacobian_double(res, curve);
+		point_jacobian_double(res, curve);
 
 		// get lowest 5 bits of a >> (i*4).
 		ashift -= 4;
@@ -532,31 +669,27 @@ void point_multiply(const ecdsa_curve *curve, const bignum256 *k, const curve_po
 
 		// negate last result to make signs of this round and the
 		// last round equal.
-		conditional_negate(sign ^ nsign, &jres.z, prime);
+		conditional_negate(sign ^ nsign, &res->z, prime);
 
 		// add odd factor
-		point_jacobian_add(&pmult[bits >> 1], &jres, curve);
+		point_jacobian_add(&pmult[bits >> 1], res, curve);
 		sign = nsign;
 	}
-	conditional_negate(sign, &jres.z, prime);
-	jacobian_to_curve(&jres, res, prime);
+	conditional_negate(sign, &res->z, prime);
 	memzero(&a, sizeof(a));
-	memzero(&jres, sizeof(jres));
 }
 
-#if USE_PRECOMPUTED_CP
-
-// res = k * G
+// res = k * P, result is left in jacobian coordinates
+// cp is a precomputed table of P multiples: cp[i][j] = (2*j+1) * 16^i * P
 // k must be a normalized number with 0 <= k < curve->order
-void scalar_multiply(const ecdsa_curve *curve, const bignum256 *k, curve_point *res)
+void point_multiply_precomputed_jacobian(const ecdsa_curve *curve, const curve_point cp[64][8], const bignum256 *k, jacobian_curve_point *res)
 {
 	assert (bn_is_less(k, &curve->order));
 
 	int i, j;
-	static CONFIDENTIAL bignum256 a;
+	CONFIDENTIAL bignum256 a;
 	uint32_t is_even = (k->val[0] & 1) - 1;
 	uint32_t lowbits;
-	static CONFIDENTIAL jacobian_curve_point jres;
 	const bignum256 *prime = &curve->prime;
 
 	// is_even = 0xffffffff if k is even, 0 otherwise.
@@ -575,9 +708,9 @@ void scalar_multiply(const ecdsa_curve *curve, const bignum256 *k, curve_point *
 	a.val[j] = tmp + 0xffff + k->val[j] - (curve->order.val[j] & is_even);
 	assert((a.val[0] & 1) != 0);
 
-	// special case 0*G:  just return zero. We don't care about constant time.
+	// special case 0*P:  just return zero. We don't care about constant time.
 	if (!is_non_zero) {
-		point_set_infinity(res);
+		point_jacobian_set_infinity(res);
 		return;
 	}
 
@@ -590,23 +723,23 @@ void scalar_multiply(const ecdsa_curve *curve, const bignum256 *k, curve_point *
 	// a[64] = 1, which is the 2^256 that we added before.
 	//
 	// Since k = a - 2^256 (mod curve->order), we can compute
-	//   k*G = sum_{i=0..63} a[i] 16^i * G
+	//   k*P = sum_{i=0..63} a[i] 16^i * P
 	//
-	// We have a big table curve->cp that stores all possible
-	// values of |a[i]| 16^i * G.
-	// curve->cp[i][j] = (2*j+1) * 16^i * G
+	// We have a big table cp that stores all possible
+	// values of |a[i]| 16^i * P.
+	// cp[i][j] = (2*j+1) * 16^i * P
 
-	// now compute  res = sum_{i=0..63} a[i] * 16^i * G step by step.
-	// initial res = |a[0]| * G.  Note that a[0] = a & 0xf if (a&0x10) != 0
+	// now compute  res = sum_{i=0..63} a[i] * 16^i * P step by step.
+	// initial res = |a[0]| * P.  Note that a[0] = a & 0xf if (a&0x10) != 0
 	// and - (16 - (a & 0xf)) otherwise.   We can compute this as
 	//   ((a ^ (((a >> 4) & 1) - 1)) & 0xf) >> 1
 	// since a is odd.
 	lowbits = a.val[0] & ((1 << 5) - 1);
 	lowbits ^= (lowbits >> 4) - 1;
 	lowbits &= 15;
-	curve_to_jacobian(&curve->cp[0][lowbits >> 1], &jres, prime);
+	curve_to_jacobian(&cp[0][lowbits >> 1], res, prime);
 	for (i = 1; i < 64; i ++) {
-		// invariant res = sign(a[i-1]) sum_{j=0..i-1} (a[j] * 16^j * G)
+		// invariant res = sign(a[i-1]) sum_{j=0..i-1} (a[j] * 16^j * P)
 
 		// shift a by 4 places.
 		for (j = 0; j < 8; j++) {
@@ -621,25 +754,361 @@ void scalar_multiply(const ecdsa_curve *curve, const bignum256 *k, curve_point *
 		lowbits &= 15;
 		// negate last result to make signs of this round and the
 		// last round equal.
-		conditional_negate((lowbits & 1) - 1, &jres.y, prime);
+		conditional_negate((lowbits & 1) - 1, &res->y, prime);
 
 		// add odd factor
-		point_jacobian_add(&curve->cp[i][lowbits >> 1], &jres, curve);
+		point_jacobian_add(&cp[i][lowbits >> 1], res, curve);
 	}
-	conditional_negate(((a.val[0] >> 4) & 1) - 1, &jres.y, prime);
-	jacobian_to_curve(&jres, res, prime);
+	conditional_negate(((a.val[0] >> 4) & 1) - 1, &res->y, prime);
 	memzero(&a, sizeof(a));
-	memzero(&jres, sizeof(jres));
 }
 
-#else
+// Fills cp with multiples of p: cp[i][j] = (2*j+1) * 16^i * p
+// to be used with point_multiply_precomputed_jacobian.
+// Every row is normalized with a single inversion.
+// returns 0 if p is the point at infinity, 1 otherwise
+int point_precompute_table(const ecdsa_curve *curve, const curve_point *p, curve_point cp[64][8])
+{
+	jacobian_curve_point row[8], base, dbl;
+	bignum256 zs[8], scratch[8], z2;
+	const bignum256 *prime = &curve->prime;
+	int i, j;
+
+	if (point_is_infinity(p)) {
+		return 0;
+	}
+	point_jacobian_set_affine(p, &base);
+	for (i = 0; i < 64; i++) {
+		// base = 16^i * p
+		// row[j] = (2*j+1) * base
+		dbl = base;
+		point_jacobian_double(&dbl, curve);
+		row[0] = base;
+		for (j = 1; j < 8; j++) {
+			row[j] = row[j-1];
+			point_jacobian_add_jacobian(&dbl, &row[j], curve);
+		}
+		// 16 * base = 15 * base + base
+		point_jacobian_add_jacobian(&row[7], &base, curve);
+
+		for (j = 0; j < 8; j++) {
+			zs[j] = row[j].z;
+		}
+		bn_inverse_batch(zs, 8, prime, scratch);
+		for (j = 0; j < 8; j++) {
+			z2 = zs[j];
+			bn_multiply(&zs[j], &z2, prime); // z^-2
+			cp[i][j].x = row[j].x;
+			bn_multiply(&z2, &cp[i][j].x, prime);
+			bn_multiply(&zs[j], &z2, prime); // z^-3
+			cp[i][j].y = row[j].y;
+			bn_multiply(&z2, &cp[i][j].y, prime);
+			bn_mod(&cp[i][j].x, prime);
+			bn_mod(&cp[i][j].y, prime);
+		}
+	}
+	return 1;
+}
+
+// returns 1 iff jacobian jp and affine p are the same finite point
+static int point_jacobian_equals_affine(const jacobian_curve_point *jp, const curve_point *p, const bignum256 *prime)
+{
+	bignum256 z2, a, b;
+
+	if (point_jacobian_is_infinity(jp, prime)) {
+		return 0;
+	}
+	// x * z^2 == X
+	z2 = jp->z;
+	bn_multiply(&jp->z, &z2, prime);
+	a = p->x;
+	bn_multiply(&z2, &a, prime);
+	bn_mod(&a, prime);
+	b = jp->x;
+	bn_fast_mod(&b, prime);
+	bn_mod(&b, prime);
+	if (!bn_is_equal(&a, &b)) {
+		return 0;
+	}
+	// y * z^3 == Y
+	bn_multiply(&jp->z, &z2, prime);
+	a = p->y;
+	bn_multiply(&z2, &a, prime);
+	bn_mod(&a, prime);
+	b = jp->y;
+	bn_fast_mod(&b, prime);
+	bn_mod(&b, prime);
+	return bn_is_equal(&a, &b);
+}
+
+// checks that cp is the table point_precompute_table builds for cp[0][0]:
+// every entry is verified against its neighbours, so no inversions are needed
+// and it's cheaper than building the table again.
+// returns 1 if the table is consistent, 0 otherwise
+int point_check_table(const ecdsa_curve *curve, const curve_point cp[64][8])
+{
+	jacobian_curve_point dbl, t;
+	const bignum256 *prime = &curve->prime;
+	int i, j;
+
+	if (point_is_infinity(&cp[0][0])) {
+		return 0;
+	}
+	for (i = 0; i < 64; i++) {
+		if (i > 0) {
+			// 16^i * p = 15 * 16^(i-1) * p + 16^(i-1) * p
+			point_jacobian_set_affine(&cp[i-1][7], &t);
+			point_jacobian_set_affine(&cp[i-1][0], &dbl);
+			point_jacobian_add_jacobian(&dbl, &t, curve);
+			if (!point_jacobian_equals_affine(&t, &cp[i][0], prime)) {
+				return 0;
+			}
+		}
+		point_jacobian_set_affine(&cp[i][0], &dbl);
+		point_jacobian_double(&dbl, curve);
+		for (j = 1; j < 8; j++) {
+			// (2*j+1) * base = (2*j-1) * base + 2 * base
+			point_jacobian_set_affine(&cp[i][j-1], &t);
+			point_jacobian_add_jacobian(&dbl, &t, curve);
+			if (!point_jacobian_equals_affine(&t, &cp[i][j], prime)) {
+				return 0;
+			}
+		}
+	}
+	return 1;
+}
+
+#if USE_WIDE_CP
+
+static curve_point wide_cp[WIDE_CP_ROWS][WIDE_CP_COLS];
+static const ecdsa_curve *wide_cp_curve = NULL;
+// WIDE_CP_EMPTY -> WIDE_CP_BUILDING -> WIDE_CP_READY, never goes back
+#define WIDE_CP_EMPTY    0
+#define WIDE_CP_BUILDING 1
+#define WIDE_CP_READY    2
+static int wide_cp_state = WIDE_CP_EMPTY;
+
+// Builds wide_cp table for the generator of the first curve it is called with,
+// the table is never rebuilt. Thread-safe: only the first caller builds the table,
+// other threads don't wait for it and get 0 until it is ready.
+// Call it once at startup to have the table ready for all threads.
+// returns 1 if the table for the curve is ready
+int scalar_multiply_init(const ecdsa_curve *curve)
+{
+	jacobian_curve_point row[WIDE_CP_COLS];
+	bignum256 zs[WIDE_CP_COLS], scratch[WIDE_CP_COLS];
+	jacobian_curve_point base, dbl;
+	bignum256 z2;
+	const bignum256 *prime = &curve->prime;
+	int i, j;
+	int state = __atomic_load_n(&wide_cp_state, __ATOMIC_ACQUIRE);
+
+	if (state == WIDE_CP_READY) {
+		return (wide_cp_curve == curve);
+	}
+	if (state != WIDE_CP_EMPTY ||
+	    !__atomic_compare_exchange_n(&wide_cp_state, &state, WIDE_CP_BUILDING, 0, __ATOMIC_ACQUIRE, __ATOMIC_ACQUIRE)) {
+		// another thread is building the table
+		return (state == WIDE_CP_READY && wide_cp_curve == curve);
+	}
+	point_jacobian_set_affine(&curve->G, &base);
+	for (i = 0; i < WIDE_CP_ROWS; i++) {
+		// base = 2^(WIDE_CP_WINDOW*i) * G
+		// row[j] = (2*j+1) * base
+		dbl = base;
+		point_jacobian_double(&dbl, curve);
+		row[0] = base;
+		for (j = 1; j < WIDE_CP_COLS; j++) {
+			row[j] = row[j-1];
+			point_jacobian_add_jacobian(&dbl, &row[j], curve);
+		}
+		// 2^WIDE_CP_WINDOW * base = (2^WIDE_CP_WINDOW - 1) * base + base
+		point_jacobian_add_jacobian(&row[WIDE_CP_COLS-1], &base, curve);
+
+		for (j = 0; j < WIDE_CP_COLS; j++) {
+			zs[j] = row[j].z;
+		}
+		bn_inverse_batch(zs, WIDE_CP_COLS, prime, scratch);
+		for (j = 0; j < WIDE_CP_COLS; j++) {
+			z2 = zs[j];
+			bn_multiply(&zs[j], &z2, prime); // z^-2
+			wide_cp[i][j].x = row[j].x;
+			bn_multiply(&z2, &wide_cp[i][j].x, prime);
+			bn_multiply(&zs[j], &z2, prime); // z^-3
+			wide_cp[i][j].y = row[j].y;
+			bn_multiply(&z2, &wide_cp[i][j].y, prime);
+			bn_mod(&wide_cp[i][j].x, prime);
+			bn_mod(&wide_cp[i][j].y, prime);
+		}
+	}
+	wide_cp_curve = curve;
+	__atomic_store_n(&wide_cp_state, WIDE_CP_READY, __ATOMIC_RELEASE);
+	return 1;
+}
+
+// Copies row[index] to res reading every entry of the row,
+// so memory access pattern doesn't depend on the index.
+static void wide_cp_select(const curve_point *row, uint32_t index, curve_point *res)
+{
+	uint32_t j, l, mask;
+	memzero(res, sizeof(curve_point));
+	for (j = 0; j < WIDE_CP_COLS; j++) {
+		// mask = 0xffffffff if j == index, 0 otherwise
+		mask = 0 - (((j ^ index) - 1) >> 31);
+		for (l = 0; l < 9; l++) {
+			res->x.val[l] |= row[j].x.val[l] & mask;
+			res->y.val[l] |= row[j].y.val[l] & mask;
+		}
+	}
+}
+
+// Same as point_multiply_precomputed_jacobian but with
+// WIDE_CP_WINDOW-bit signed digits instead of 4-bit ones.
+static void scalar_multiply_wide_jacobian(const ecdsa_curve *curve, const bignum256 *k, jacobian_curve_point *res)
+{
+	assert (bn_is_less(k, &curve->order));
+
+	int i, j;
+	CONFIDENTIAL bignum256 a;
+	CONFIDENTIAL curve_point p;
+	uint32_t is_even = (k->val[0] & 1) - 1;
+	uint32_t lowbits;
+	const bignum256 *prime = &curve->prime;
+	const uint32_t mask = (1 << WIDE_CP_WINDOW) - 1;
+
+	// a = k + 2^256, made odd by subtracting the order if k is even
+	uint32_t tmp = 1;
+	uint32_t is_non_zero = 0;
+	for (j = 0; j < 8; j++) {
+		is_non_zero |= k->val[j];
+		tmp += 0x3fffffff + k->val[j] - (curve->order.val[j] & is_even);
+		a.val[j] = tmp & 0x3fffffff;
+		tmp >>= 30;
+	}
+	is_non_zero |= k->val[j];
+	a.val[j] = tmp + 0xffff + k->val[j] - (curve->order.val[j] & is_even);
+	assert((a.val[0] & 1) != 0);
+
+	if (!is_non_zero) {
+		point_jacobian_set_infinity(res);
+		return;
+	}
+
+	// a = sum_{i=0..WIDE_CP_ROWS} a[i] 2^(WIDE_CP_WINDOW*i) with odd
+	// |a[i]| < 2^WIDE_CP_WINDOW, see point_multiply_precomputed_jacobian
+	lowbits = a.val[0] & ((mask << 1) | 1);
+	lowbits ^= (lowbits >> WIDE_CP_WINDOW) - 1;
+	lowbits &= mask;
+	wide_cp_select(wide_cp[0], lowbits >> 1, &p);
+	curve_to_jacobian(&p, res, prime);
+	for (i = 1; i < WIDE_CP_ROWS; i ++) {
+		for (j = 0; j < 8; j++) {
+			a.val[j] = (a.val[j] >> WIDE_CP_WINDOW) | ((a.val[j + 1] & mask) << (30 - WIDE_CP_WINDOW));
+		}
+		a.val[j] >>= WIDE_CP_WINDOW;
+
+		lowbits = a.val[0] & ((mask << 1) | 1);
+		lowbits ^= (lowbits >> WIDE_CP_WINDOW) - 1;
+		lowbits &= mask;
+		conditional_negate((lowbits & 1) - 1, &res->y, prime);
 
+		wide_cp_select(wide_cp[i], lowbits >> 1, &p);
+		point_jacobian_add(&p, res, curve);
+	}
+	conditional_negate(((a.val[0] >> WIDE_CP_WINDOW) & 1) - 1, &res->y, prime);
+	memzero(&a, sizeof(a));
+	memzero(&p, sizeof(p));
+}
+
+#endif
+
+// res = k * G
+// k must be a normalized number with 0 <= k < curve->order
 void scalar_multiply(const ecdsa_curve *curve, const bignum256 *k, curve_point *res)
 {
-	point_multiply(curve, k, &curve->G, res);
+	CONFIDENTIAL jacobian_curve_point jres;
+	scalar_multiply_jacobian(curve, k, &jres);
+	point_jacobian_normalize(&jres, res, &curve->prime);
+	memzero(&jres, sizeof(jres));
 }
 
+// res = k * G, result is left in jacobian coordinates
+void scalar_multiply_jacobian(const ecdsa_curve *curve, const bignum256 *k, jacobian_curve_point *res)
+{
+#if USE_WIDE_CP
+	if (scalar_multiply_init(curve)) {
+		scalar_multiply_wide_jacobian(curve, k, res);
+		return;
+	}
 #endif
+#if USE_PRECOMPUTED_CP
+	point_multiply_precomputed_jacobian(curve, curve->cp, k, res);
+#else
+	point_multiply_jacobian(curve, k, &curve->G, res);
+#endif
+}
+
+// returns count bits of a starting from bit start, count <= 30
+static uint32_t bn_get_bits(const bignum256 *a, int start, int count)
+{
+	int limb = start / 30;
+	int shift = start % 30;
+	uint32_t bits = a->val[limb] >> shift;
+	if (shift + count > 30 && limb < 8) {
+		bits |= a->val[limb + 1] << (30 - shift);
+	}
+	return bits & ((1u << count) - 1);
+}
+
+// res = k[0] * p[0] + ... + k[n-1] * p[n-1], result is left in jacobian coordinates.
+// Pippenger's bucket method: every window of the scalars costs n additions
+// plus 2 * 2^window additions to sum up the buckets.
+// buckets must have space for (1 << window) - 1 points, window <= 30.
+// k must be normalized numbers with 0 <= k < curve->order.
+// The timing depends on the scalars, don't use it with secret scalars.
+void point_multiply_multi(const ecdsa_curve *curve, size_t n, const bignum256 *k, const curve_point *p, int window, jacobian_curve_point *buckets, jacobian_curve_point *res)
+{
+	const bignum256 *prime = &curve->prime;
+	size_t nbuckets = ((size_t)1 << window) - 1;
+	jacobian_curve_point running, sum;
+	int start, count, i;
+	size_t j;
+	uint32_t digit;
+
+	point_jacobian_set_infinity(res);
+	for (start = ((256 - 1) / window) * window; start >= 0; start -= window) {
+		count = (start + window > 256) ? (256 - start) : window;
+		if (!point_jacobian_is_infinity(res, prime)) {
+			for (i = 0; i < window; i++) {
+				point_jacobian_double(res, curve);
+			}
+		}
+		for (j = 0; j < nbuckets; j++) {
+			point_jacobian_set_infinity(&buckets[j]);
+		}
+		for (j = 0; j < n; j++) {
+			digit = bn_get_bits(&k[j], start, count);
+			if (digit == 0 || point_is_infinity(&p[j])) {
+				continue;
+			}
+			// point_jacobian_add handles p = bucket and p = -bucket,
+			// but not an empty bucket
+			if (point_jacobian_is_infinity(&buckets[digit - 1], prime)) {
+				point_jacobian_set_affine(&p[j], &buckets[digit - 1]);
+			} else {
+				point_jacobian_add(&p[j], &buckets[digit - 1], curve);
+			}
+		}
+		// sum = 1 * bucket[0] + 2 * bucket[1] + ... + nbuckets * bucket[nbuckets-1]
+		point_jacobian_set_infinity(&running);
+		point_jacobian_set_infinity(&sum);
+		for (j = nbuckets; j > 0; j--) {
+			point_jacobian_add_jacobian(&buckets[j - 1], &running, curve);
+			point_jacobian_add_jacobian(&running, &sum, curve);
+		}
+		point_jacobian_add_jacobian(&sum, res, curve);
+	}
+}
 
 int ecdh_multiply(const ecdsa_curve *curve, const uint8_t *priv_key, const uint8_t *pub_key, uint8_t *session_key)
 {
@@ -34,6 +34,12 @@ typedef struct {
 	bignum256 x, y;
 } curve_point;
 
+// curve point in jacobian coordinates: x = X/Z^2, y = Y/Z^3
+// point at infinity has Z = 0
+typedef struct jacobian_curve_point {
+	bignum256 x, y, z;
+} jacobian_curve_point;
+
 typedef struct {
 
 	bignum256 prime;       // prime order of the finite field
@@ -49,6 +55,15 @@ typedef struct {
 
 } ecdsa_curve;
 
+#if USE_WIDE_CP
+#if WIDE_CP_WINDOW != 4 && WIDE_CP_WINDOW != 8
+#error "WIDE_CP_WINDOW must be 4 or 8"
+#endif
+// wide_cp[i][j] = (2*j+1) * 2^(WIDE_CP_WINDOW*i) * G
+#define WIDE_CP_ROWS (256 / WIDE_CP_WINDOW)
+#define WIDE_CP_COLS (1 << (WIDE_CP_WINDOW - 1))
+#endif
+
 // 4 byte prefix + 40 byte data (segwit)
 // 1 byte prefix + 64 byte data (cashaddr)
 #define MAX_ADDR_RAW_SIZE 65
@@ -76,6 +91,26 @@ int point_is_infinity(const curve_point *p);
 int point_is_equal(const curve_point *p, const curve_point *q);
 int point_is_negative_of(const curve_point *p, const curve_point *q);
 void scalar_multiply(const ecdsa_curve *curve, const bignum256 *k, curve_point *res);
+
+void curve_to_jacobian(const curve_point *p, jacobian_curve_point *jp, const bignum256 *prime);
+void jacobian_to_curve(const jacobian_curve_point *jp, curve_point *p, const bignum256 *prime);
+void point_jacobian_add(const curve_point *p1, jacobian_curve_point *p2, const ecdsa_curve *curve);
+void point_jacobian_double(jacobian_curve_point *p, const ecdsa_curve *curve);
+void point_jacobian_set_affine(const curve_point *p, jacobian_curve_point *jp);
+void point_jacobian_set_infinity(jacobian_curve_point *p);
+int point_jacobian_is_infinity(const jacobian_curve_point *p, const bignum256 *prime);
+void point_jacobian_negate(jacobian_curve_point *p, const bignum256 *prime);
+void point_jacobian_add_jacobian(const jacobian_curve_point *p1, jacobian_curve_point *p2, const ecdsa_curve *curve);
+void point_jacobian_normalize(const jacobian_curve_point *jp, curve_point *p, const bignum256 *prime);
+void point_multiply_jacobian(const ecdsa_curve *curve, const bignum256 *k, const curve_point *p, jacobian_curve_point *res);
+void scalar_multiply_jacobian(const ecdsa_curve *curve, const bignum256 *k, jacobian_curve_point *res);
+void point_multiply_precomputed_jacobian(const ecdsa_curve *curve, const curve_point cp[64][8], const bignum256 *k, jacobian_curve_point *res);
+void point_multiply_multi(const ecdsa_curve *curve, size_t n, const bignum256 *k, const curve_point *p, int window, jacobian_curve_point *buckets, jacobian_curve_point *res);
+int point_precompute_table(const ecdsa_curve *curve, const curve_point *p, curve_point cp[64][8]);
+int point_check_table(const ecdsa_curve *curve, const curve_point cp[64][8]);
+#if USE_WIDE_CP
+int scalar_multiply_init(const ecdsa_curve *curve);
+#endif
 int ecdh_multiply(const ecdsa_curve *curve, const uint8_t *priv_key, const uint8_t *pub_key, uint8_t *session_key);
 void uncompress_coords(const ecdsa_curve *curve, uint8_t odd, const bignum256 *x, bignum256 *y);
 int ecdsa_uncompress_pubkey(const ecdsa_curve *curve, const uint8_t *pub_key, uint8_t *uncompressed);
@@ -32,20 +32,9 @@
 
 void hmac_sha256_Init(HMAC_SHA256_CTX *hctx, const uint8_t *key, const uint32_t keylen)
 {
-	static CONFIDENTIAL uint8_t i_key_pad[SHA256_BLOCK_LENGTH];
-	memset(i_key_pad, 0, SHA256_BLOCK_LENGTH);
-	if (keylen > SHA256_BLOCK_LENGTH) {
-		sha256_Raw(key, keylen, i_key_pad);
-	} else {
-		memcpy(i_key_pad, key, keylen);
-	}
-	for (int i = 0; i < SHA256_BLOCK_LENGTH; i++) {
-		hctx->o_key_pad[i] = i_key_pad[i] ^ 0x5c;
-		i_key_pad[i] ^= 0x36;
-	}
 	sha256_Init(&(hctx->ctx));
-	sha256_Update(&(hctx->ctx), i_key_pad, SHA256_BLOCK_LENGTH);
-	memzero(i_key_pad, sizeof(i_key_pad));
+	hmac_sha256_prepare(key, keylen, hctx->odig, hctx->ctx.state);
+	hctx->ctx.bitcount = SHA256_BLOCK_LENGTH * 8;
 }
 
 void hmac_sha256_Update(HMAC_SHA256_CTX *hctx, const uint8_t *msg, const uint32_t msglen)
@@ -57,7 +46,8 @@ void hmac_sha256_Final(HMAC_SHA256_CTX *hctx, uint8_t *hmac)
 {
 	sha256_Final(&(hctx->ctx), hmac);
 	sha256_Init(&(hctx->ctx));
-	sha256_Update(&(hctx->ctx), hctx->o_key_pad, SHA256_BLOCK_LENGTH);
+	memcpy(hctx->ctx.state, hctx->odig, sizeof(hctx->odig));
+	hctx->ctx.bitcount = SHA256_BLOCK_LENGTH * 8;
 	sha256_Update(&(hctx->ctx), hmac, SHA256_DIGEST_LENGTH);
 	sha256_Final(&(hctx->ctx), hmac);
 	memzero(hctx, sizeof(HMAC_SHA256_CTX));
@@ -65,7 +55,7 @@ void hmac_sha256_Final(HMAC_SHA256_CTX *hctx, uint8_t *hmac)
 
 void hmac_sha256(const uint8_t *key, const uint32_t keylen, const uint8_t *msg, const uint32_t msglen, uint8_t *hmac)
 {
-	static CONFIDENTIAL HMAC_SHA256_CTX hctx;
+	CONFIDENTIAL HMAC_SHA256_CTX hctx;
 	hmac_sha256_Init(&hctx, key, keylen);
 	hmac_sha256_Update(&hctx, msg, msglen);
 	hmac_sha256_Final(&hctx, hmac);
@@ -73,11 +63,11 @@ void hmac_sha256(const uint8_t *key, const uint32_t keylen, const uint8_t *msg,
 
 void hmac_sha256_prepare(const uint8_t *key, const uint32_t keylen, uint32_t *opad_digest, uint32_t *ipad_digest)
 {
-	static CONFIDENTIAL uint32_t key_pad[SHA256_BLOCK_LENGTH/sizeof(uint32_t)];
+	uint32_t key_pad[SHA256_BLOCK_LENGTH/sizeof(uint32_t)];
 
 	memzero(key_pad, sizeof(key_pad));
 	if (keylen > SHA256_BLOCK_LENGTH) {
-		static CONFIDENTIAL SHA256_CTX context;
+		SHA256_CTX context;
 		sha256_Init(&context);
 		sha256_Update(&context, key, keylen);
 		sha256_Final(&context, (uint8_t*)key_pad);
@@ -107,20 +97,10 @@ void hmac_sha256_prepare(const uint8_t *key, const uint32_t keylen, uint32_t *op
 
 void hmac_sha512_Init(HMAC_SHA512_CTX *hctx, const uint8_t *key, const uint32_t keylen)
 {
-	static CONFIDENTIAL uint8_t i_key_pad[SHA512_BLOCK_LENGTH];
-	memset(i_key_pad, 0, SHA512_BLOCK_LENGTH);
-	if (keylen > SHA512_BLOCK_LENGTH) {
-		sha512_Raw(key, keylen, i_key_pad);
-	} else {
-		memcpy(i_key_pad, key, keylen);
-	}
-	for (int i = 0; i < SHA512_BLOCK_LENGTH; i++) {
-		hctx->o_key_pad[i] = i_key_pad[i] ^ 0x5c;
-		i_key_pad[i] ^= 0x36;
-	}
 	sha512_Init(&(hctx->ctx));
-	sha512_Update(&(hctx->ctx), i_key_pad, SHA512_BLOCK_LENGTH);
-	memzero(i_key_pad, sizeof(i_key_pad));
+	hmac_sha512_prepare(key, keylen, hctx->odig, hctx->ctx.state);
+	hctx->ctx.bitcount[0] = SHA512_BLOCK_LENGTH * 8;
+	hctx->ctx.bitcount[1] = 0;
 }
 
 void hmac_sha512_Update(HMAC_SHA512_CTX *hctx, const uint8_t *msg, const uint32_t msglen)
@@ -132,7 +112,9 @@ void hmac_sha512_Final(HMAC_SHA512_CTX *hctx, uint8_t *hmac)
 {
 	sha512_Final(&(hctx->ctx), hmac);
 	sha512_Init(&(hctx->ctx));
-	sha512_Update(&(hctx->ctx), hctx->o_key_pad, SHA512_BLOCK_LENGTH);
+	memcpy(hctx->ctx.state, hctx->odig, sizeof(hctx->odig));
+	hctx->ctx.bitcount[0] = SHA512_BLOCK_LENGTH * 8;
+	hctx->ctx.bitcount[1] = 0;
 	sha512_Update(&(hctx->ctx), hmac, SHA512_DIGEST_LENGTH);
 	sha512_Final(&(hctx->ctx), hmac);
 	memzero(hctx, sizeof(HMAC_SHA512_CTX));
@@ -148,11 +130,11 @@ void hmac_sha512(const uint8_t *key, const uint32_t keylen, const uint8_t *msg,
 
 void hmac_sha512_prepare(const uint8_t *key, const uint32_t keylen, uint64_t *opad_digest, uint64_t *ipad_digest)
 {
-	static CONFIDENTIAL uint64_t key_pad[SHA512_BLOCK_LENGTH/sizeof(uint64_t)];
+	uint64_t key_pad[SHA512_BLOCK_LENGTH/sizeof(uint64_t)];
 
 	memzero(key_pad, sizeof(key_pad));
 	if (keylen > SHA512_BLOCK_LENGTH) {
-		static CONFIDENTIAL SHA512_CTX context;
+		SHA512_CTX context;
 		sha512_Init(&context);
 		sha512_Update(&context, key, keylen);
 		sha512_Final(&context, (uint8_t*)key_pad);
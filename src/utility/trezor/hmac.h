@@ -27,13 +27,16 @@
 #include <stdint.h>
 #include "sha2.h"
 
+// Both key pads are hashed in Init, ctx and odig keep their midstates.
+// A copy of the context right after Init can be used to compute
+// another HMAC with the same key without hashing the pads again.
 typedef struct _HMAC_SHA256_CTX {
-	uint8_t o_key_pad[SHA256_BLOCK_LENGTH];
+	uint32_t odig[SHA256_DIGEST_LENGTH / sizeof(uint32_t)];
 	SHA256_CTX ctx;
 } HMAC_SHA256_CTX;
 
 typedef struct _HMAC_SHA512_CTX {
-	uint8_t o_key_pad[SHA512_BLOCK_LENGTH];
+	uint64_t odig[SHA512_DIGEST_LENGTH / sizeof(uint64_t)];
 	SHA512_CTX ctx;
 } HMAC_SHA512_CTX;
 
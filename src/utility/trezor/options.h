@@ -28,6 +28,34 @@
 #define USE_PRECOMPUTED_CP 1
 #endif
 
+// use a wide-window table of multiples of G generated at runtime
+// instead of the compiled-in one. Intended for hosts with plenty of RAM,
+// the table takes (256 / WIDE_CP_WINDOW) * 2^(WIDE_CP_WINDOW-1) * 64 bytes
+// (256 kB for the default window of 8 bits)
+#ifndef USE_WIDE_CP
+#define USE_WIDE_CP 0
+#endif
+
+#ifndef WIDE_CP_WINDOW
+#define WIDE_CP_WINDOW 8
+#endif
+
+// use x86 SHA extensions for SHA-256 if the CPU supports them,
+// the CPU is checked once at runtime
+#ifndef USE_SHA2_X86
+#if (defined(__x86_64__) || defined(__i386__)) && (defined(__GNUC__) || defined(__clang__)) && !defined(ARDUINO)
+#define USE_SHA2_X86 1
+#else
+#define USE_SHA2_X86 0
+#endif
+#endif
+
+// hash many 32-byte messages with RIPEMD-160 in parallel
+// using SSE2 / AVX2 / AVX-512 lanes, the CPU is checked once at runtime
+#ifndef USE_RIPEMD160_X86
+#define USE_RIPEMD160_X86 USE_SHA2_X86
+#endif
+
 // use fast inverse method
 #ifndef USE_INVERSE_FAST
 #define USE_INVERSE_FAST 1
@@ -43,10 +71,23 @@
 #define USE_RFC6979 1
 #endif
 
-// implement BIP32 caching
+// implement BIP32 caching: LRU cache of BIP32_CACHE_SIZE intermediate nodes
+// used by HDPrivateKey::derive and HDPublicKey::derive,
+// paths longer than BIP32_CACHE_MAXDEPTH+1 are not cached.
+// The cache takes about 6.5 kB of RAM and keeps private nodes
+// until they are evicted or clearDerivationCache() is called,
+// so it is enabled only on hosts by default
 #ifndef USE_BIP32_CACHE
+#if !defined(ARDUINO) && !defined(__MBED__) && (defined(__x86_64__) || defined(__i386__) || defined(__aarch64__))
 #define USE_BIP32_CACHE 1
+#else
+#define USE_BIP32_CACHE 0
+#endif
+#endif
+#ifndef BIP32_CACHE_SIZE
 #define BIP32_CACHE_SIZE 10
+#endif
+#ifndef BIP32_CACHE_MAXDEPTH
 #define BIP32_CACHE_MAXDEPTH 8
 #endif
 
@@ -29,27 +29,27 @@
 
 void pbkdf2_hmac_sha256_Init(PBKDF2_HMAC_SHA256_CTX *pctx, const uint8_t *pass, int passlen, const uint8_t *salt, int saltlen, uint32_t blocknr)
 {
-	SHA256_CTX ctx;
+	HMAC_SHA256_CTX hctx;
 #if BYTE_ORDER == LITTLE_ENDIAN
 	REVERSE32(blocknr, blocknr);
 #endif
 
-	hmac_sha256_prepare(pass, passlen, pctx->odig, pctx->idig);
+	// key pad midstates are kept for the other iterations
+	hmac_sha256_Init(&hctx, pass, passlen);
+	memcpy(pctx->idig, hctx.ctx.state, sizeof(pctx->idig));
+	memcpy(pctx->odig, hctx.odig, sizeof(pctx->odig));
 	memzero(pctx->g, sizeof(pctx->g));
 	pctx->g[8] = 0x80000000;
 	pctx->g[15] = (SHA256_BLOCK_LENGTH + SHA256_DIGEST_LENGTH) * 8;
 
-	memcpy (ctx.state, pctx->idig, sizeof(pctx->idig));
-	ctx.bitcount = SHA256_BLOCK_LENGTH * 8;
-	sha256_Update(&ctx, salt, saltlen);
-	sha256_Update(&ctx, (uint8_t*)&blocknr, sizeof(blocknr));
-	sha256_Final(&ctx, (uint8_t*)pctx->g);
+	hmac_sha256_Update(&hctx, salt, saltlen);
+	hmac_sha256_Update(&hctx, (uint8_t*)&blocknr, sizeof(blocknr));
+	hmac_sha256_Final(&hctx, (uint8_t*)pctx->g);
 #if BYTE_ORDER == LITTLE_ENDIAN
 	for (uint32_t k = 0; k < SHA256_DIGEST_LENGTH / sizeof(uint32_t); k++) {
 		REVERSE32(pctx->g[k], pctx->g[k]);
 	}
 #endif
-	sha256_Transform(pctx->odig, pctx->g, pctx->g);
 	memcpy(pctx->f, pctx->g, SHA256_DIGEST_LENGTH);
 	pctx->first = 1;
 }
@@ -103,28 +103,27 @@ void pbkdf2_hmac_sha256(const uint8_t *pass, int passlen, const uint8_t *salt, i
 
 void pbkdf2_hmac_sha512_Init(PBKDF2_HMAC_SHA512_CTX *pctx, const uint8_t *pass, int passlen, const uint8_t *salt, int saltlen, uint32_t blocknr)
 {
-	SHA512_CTX ctx;
+	HMAC_SHA512_CTX hctx;
 #if BYTE_ORDER == LITTLE_ENDIAN
 	REVERSE32(blocknr, blocknr);
 #endif
 
-	hmac_sha512_prepare(pass, passlen, pctx->odig, pctx->idig);
+	// key pad midstates are kept for the other iterations
+	hmac_sha512_Init(&hctx, pass, passlen);
+	memcpy(pctx->idig, hctx.ctx.state, sizeof(pctx->idig));
+	memcpy(pctx->odig, hctx.odig, sizeof(pctx->odig));
 	memzero(pctx->g, sizeof(pctx->g));
 	pctx->g[8] = 0x8000000000000000;
 	pctx->g[15] = (SHA512_BLOCK_LENGTH + SHA512_DIGEST_LENGTH) * 8;
 
-	memcpy (ctx.state, pctx->idig, sizeof(pctx->idig));
-	ctx.bitcount[0] = SHA512_BLOCK_LENGTH * 8;
-	ctx.bitcount[1] = 0;
-	sha512_Update(&ctx, salt, saltlen);
-	sha512_Update(&ctx, (uint8_t*)&blocknr, sizeof(blocknr));
-	sha512_Final(&ctx, (uint8_t*)pctx->g);
+	hmac_sha512_Update(&hctx, salt, saltlen);
+	hmac_sha512_Update(&hctx, (uint8_t*)&blocknr, sizeof(blocknr));
+	hmac_sha512_Final(&hctx, (uint8_t*)pctx->g);
 #if BYTE_ORDER == LITTLE_ENDIAN
 	for (uint32_t k = 0; k < SHA512_DIGEST_LENGTH / sizeof(uint64_t); k++) {
 		REVERSE64(pctx->g[k], pctx->g[k]);
 	}
 #endif
-	sha512_Transform(pctx->odig, pctx->g, pctx->g);
 	memcpy(pctx->f, pctx->g, SHA512_DIGEST_LENGTH);
 	pctx->first = 1;
 }
@@ -141,6 +140,43 @@ void pbkdf2_hmac_sha512_Update(PBKDF2_HMAC_SHA512_CTX *pctx, uint32_t iterations
 	pctx->first = 0;
 }
 
+// Same as pbkdf2_hmac_sha512_Update for an array of n contexts,
+// several contexts are processed in parallel if the CPU allows it
+void pbkdf2_hmac_sha512_Update_many(PBKDF2_HMAC_SHA512_CTX *pctx, size_t n, uint32_t iterations)
+{
+	uint64_t idig[8][8], odig[8][8], f[8][8], g[8][8];
+	while (n > 0) {
+		size_t m = (n < 8) ? n : 8;
+		char first = pctx[0].first;
+		for (size_t i = 1; i < m; i++) {
+			if (pctx[i].first != first) {
+				m = i;
+				break;
+			}
+		}
+		for (size_t i = 0; i < m; i++) {
+			memcpy(idig[i], pctx[i].idig, sizeof(idig[i]));
+			memcpy(odig[i], pctx[i].odig, sizeof(odig[i]));
+			memcpy(f[i], pctx[i].f, sizeof(f[i]));
+			memcpy(g[i], pctx[i].g, sizeof(g[i]));
+		}
+		if (iterations > (uint32_t)first) {
+			sha512_HmacIterate_many(idig[0], odig[0], f[0], g[0], m, iterations - first);
+		}
+		for (size_t i = 0; i < m; i++) {
+			memcpy(pctx[i].f, f[i], sizeof(f[i]));
+			memcpy(pctx[i].g, g[i], sizeof(g[i]));
+			pctx[i].first = 0;
+		}
+		pctx += m;
+		n -= m;
+	}
+	memzero(idig, sizeof(idig));
+	memzero(odig, sizeof(odig));
+	memzero(f, sizeof(f));
+	memzero(g, sizeof(g));
+}
+
 void pbkdf2_hmac_sha512_Final(PBKDF2_HMAC_SHA512_CTX *pctx, uint8_t *key)
 {
 #if BYTE_ORDER == LITTLE_ENDIAN
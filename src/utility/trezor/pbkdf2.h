@@ -25,6 +25,7 @@
 #define __PBKDF2_H__
 
 #include <stdint.h>
+#include <stddef.h>
 #include "sha2.h"
 
 typedef struct _PBKDF2_HMAC_SHA256_CTX {
@@ -43,6 +44,11 @@ typedef struct _PBKDF2_HMAC_SHA512_CTX {
 	char first;
 } PBKDF2_HMAC_SHA512_CTX;
 
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
 void pbkdf2_hmac_sha256_Init(PBKDF2_HMAC_SHA256_CTX *pctx, const uint8_t *pass, int passlen, const uint8_t *salt, int saltlen, uint32_t blocknr);
 void pbkdf2_hmac_sha256_Update(PBKDF2_HMAC_SHA256_CTX *pctx, uint32_t iterations);
 void pbkdf2_hmac_sha256_Final(PBKDF2_HMAC_SHA256_CTX *pctx, uint8_t *key);
@@ -52,5 +58,10 @@ void pbkdf2_hmac_sha512_Init(PBKDF2_HMAC_SHA512_CTX *pctx, const uint8_t *pass,
 void pbkdf2_hmac_sha512_Update(PBKDF2_HMAC_SHA512_CTX *pctx, uint32_t iterations);
 void pbkdf2_hmac_sha512_Final(PBKDF2_HMAC_SHA512_CTX *pctx, uint8_t *key);
 void pbkdf2_hmac_sha512(const uint8_t *pass, int passlen, const uint8_t *salt, int saltlen, uint32_t iterations, uint8_t *key, int keylen);
+void pbkdf2_hmac_sha512_Update_many(PBKDF2_HMAC_SHA512_CTX *pctx, size_t n, uint32_t iterations);
+
+#ifdef __cplusplus
+} /* end of extern "C" */
+#endif
 
 #endif
@@ -29,6 +29,22 @@
 static uint32_t seed = 0;
 static uint8_t hash[32];
 
+// one process-wide state, so random_reseed() reaches every thread;
+// a spinlock keeps EC multiplications in several threads from racing on it
+#ifdef __GNUC__
+static char rand_lock = 0;
+static void rand_acquire(void){
+	while(__atomic_test_and_set(&rand_lock, __ATOMIC_ACQUIRE)){
+	}
+}
+static void rand_release(void){
+	__atomic_clear(&rand_lock, __ATOMIC_RELEASE);
+}
+#else
+static void rand_acquire(void){}
+static void rand_release(void){}
+#endif
+
 /* 
  * On boot there is random some device-dependent junk in the RAM
  * It may depend on the platform, but in most cases it can be used
@@ -51,10 +67,13 @@ static void init_ram_seed(){
 
 void random_reseed(const uint32_t value)
 {
+	rand_acquire();
 	seed = value;
+	rand_release();
 }
 
 uint32_t __attribute__((weak)) random32(void){
+	rand_acquire();
 	if(seed == 0){
 		init_ram_seed();
 	}
@@ -65,7 +84,9 @@ uint32_t __attribute__((weak)) random32(void){
 	sha256_Final(&context, hash);
 	uint32_t * results = (uint32_t *)hash;
 	seed = results[0];
-	return results[1];
+	uint32_t r = results[1];
+	rand_release();
+	return r;
 }
 
 // #endif /* RAND_PLATFORM_INDEPENDENT */
@@ -29,6 +29,7 @@
 
 #include "ripemd160.h"
 #include "memzero.h"
+#include "options.h"
 
 /*
  * 32-bit integer manipulation macros (little endian)
@@ -53,6 +54,11 @@
 }
 #endif
 
+static const uint32_t ripemd160_initial_state[5] =
+{
+    0x67452301, 0xEFCDAB89, 0x98BADCFE, 0x10325476, 0xC3D2E1F0
+};
+
 /*
  * RIPEMD-160 context setup
  */
@@ -99,147 +105,7 @@ void ripemd160_process( RIPEMD160_CTX *ctx, const uint8_t data[RIPEMD160_BLOCK_L
     D = Dp = ctx->state[3];
     E = Ep = ctx->state[4];
 
-#define F1( x, y, z )   ( x ^ y ^ z )
-#define F2( x, y, z )   ( ( x & y ) | ( ~x & z ) )
-#define F3( x, y, z )   ( ( x | ~y ) ^ z )
-#define F4( x, y, z )   ( ( x & z ) | ( y & ~z ) )
-#define F5( x, y, z )   ( x ^ ( y | ~z ) )
-
-#define S( x, n ) ( ( x << n ) | ( x >> (32 - n) ) )
-
-#define P( a, b, c, d, e, r, s, f, k )      \
-    a += f( b, c, d ) + X[r] + k;           \
-    a = S( a, s ) + e;                      \
-    c = S( c, 10 );
-
-#define P2( a, b, c, d, e, r, s, rp, sp )   \
-    P( a, b, c, d, e, r, s, F, K );         \
-    P( a ## p, b ## p, c ## p, d ## p, e ## p, rp, sp, Fp, Kp );
-
-#define F   F1
-#define K   0x00000000
-#define Fp  F5
-#define Kp  0x50A28BE6
-    P2( A, B, C, D, E,  0, 11,  5,  8 );
-    P2( E, A, B, C, D,  1, 14, 14,  9 );
-    P2( D, E, A, B, C,  2, 15,  7,  9 );
-    P2( C, D, E, A, B,  3, 12,  0, 11 );
-    P2( B, C, D, E, A,  4,  5,  9, 13 );
-    P2( A, B, C, D, E,  5,  8,  2, 15 );
-    P2( E, A, B, C, D,  6,  7, 11, 15 );
-    P2( D, E, A, B, C,  7,  9,  4,  5 );
-    P2( C, D, E, A, B,  8, 11, 13,  7 );
-    P2( B, C, D, E, A,  9, 13,  6,  7 );
-    P2( A, B, C, D, E, 10, 14, 15,  8 );
-    P2( E, A, B, C, D, 11, 15,  8, 11 );
-    P2( D, E, A, B, C, 12,  6,  1, 14 );
-    P2( C, D, E, A, B, 13,  7, 10, 14 );
-    P2( B, C, D, E, A, 14,  9,  3, 12 );
-    P2( A, B, C, D, E, 15,  8, 12,  6 );
-#undef F
-#undef K
-#undef Fp
-#undef Kp
-
-#define F   F2
-#define K   0x5A827999
-#define Fp  F4
-#define Kp  0x5C4DD124
-    P2( E, A, B, C, D,  7,  7,  6,  9 );
-    P2( D, E, A, B, C,  4,  6, 11, 13 );
-    P2( C, D, E, A, B, 13,  8,  3, 15 );
-    P2( B, C, D, E, A,  1, 13,  7,  7 );
-    P2( A, B, C, D, E, 10, 11,  0, 12 );
-    P2( E, A, B, C, D,  6,  9, 13,  8 );
-    P2( D, E, A, B, C, 15,  7,  5,  9 );
-    P2( C, D, E, A, B,  3, 15, 10, 11 );
-    P2( B, C, D, E, A, 12,  7, 14,  7 );
-    P2( A, B, C, D, E,  0, 12, 15,  7 );
-    P2( E, A, B, C, D,  9, 15,  8, 12 );
-    P2( D, E, A, B, C,  5,  9, 12,  7 );
-    P2( C, D, E, A, B,  2, 11,  4,  6 );
-    P2( B, C, D, E, A, 14,  7,  9, 15 );
-    P2( A, B, C, D, E, 11, 13,  1, 13 );
-    P2( E, A, B, C, D,  8, 12,  2, 11 );
-#undef F
-#undef K
-#undef Fp
-#undef Kp
-
-#define F   F3
-#define K   0x6ED9EBA1
-#define Fp  F3
-#define Kp  0x6D703EF3
-    P2( D, E, A, B, C,  3, 11, 15,  9 );
-    P2( C, D, E, A, B, 10, 13,  5,  7 );
-    P2( B, C, D, E, A, 14,  6,  1, 15 );
-    P2( A, B, C, D, E,  4,  7,  3, 11 );
-    P2( E, A, B, C, D,  9, 14,  7,  8 );
-    P2( D, E, A, B, C, 15,  9, 14,  6 );
-    P2( C, D, E, A, B,  8, 13,  6,  6 );
-    P2( B, C, D, E, A,  1, 15,  9, 14 );
-    P2( A, B, C, D, E,  2, 14, 11, 12 );
-    P2( E, A, B, C, D,  7,  8,  8, 13 );
-    P2( D, E, A, B, C,  0, 13, 12,  5 );
-    P2( C, D, E, A, B,  6,  6,  2, 14 );
-    P2( B, C, D, E, A, 13,  5, 10, 13 );
-    P2( A, B, C, D, E, 11, 12,  0, 13 );
-    P2( E, A, B, C, D,  5,  7,  4,  7 );
-    P2( D, E, A, B, C, 12,  5, 13,  5 );
-#undef F
-#undef K
-#undef Fp
-#undef Kp
-
-#define F   F4
-#define K   0x8F1BBCDC
-#define Fp  F2
-#define Kp  0x7A6D76E9
-    P2( C, D, E, A, B,  1, 11,  8, 15 );
-    P2( B, C, D, E, A,  9, 12,  6,  5 );
-    P2( A, B, C, D, E, 11, 14,  4,  8 );
-    P2( E, A, B, C, D, 10, 15,  1, 11 );
-    P2( D, E, A, B, C,  0, 14,  3, 14 );
-    P2( C, D, E, A, B,  8, 15, 11, 14 );
-    P2( B, C, D, E, A, 12,  9, 15,  6 );
-    P2( A, B, C, D, E,  4,  8,  0, 14 );
-    P2( E, A, B, C, D, 13,  9,  5,  6 );
-    P2( D, E, A, B, C,  3, 14, 12,  9 );
-    P2( C, D, E, A, B,  7,  5,  2, 12 );
-    P2( B, C, D, E, A, 15,  6, 13,  9 );
-    P2( A, B, C, D, E, 14,  8,  9, 12 );
-    P2( E, A, B, C, D,  5,  6,  7,  5 );
-    P2( D, E, A, B, C,  6,  5, 10, 15 );
-    P2( C, D, E, A, B,  2, 12, 14,  8 );
-#undef F
-#undef K
-#undef Fp
-#undef Kp
-
-#define F   F5
-#define K   0xA953FD4E
-#define Fp  F1
-#define Kp  0x00000000
-    P2( B, C, D, E, A,  4,  9, 12,  8 );
-    P2( A, B, C, D, E,  0, 15, 15,  5 );
-    P2( E, A, B, C, D,  5,  5, 10, 12 );
-    P2( D, E, A, B, C,  9, 11,  4,  9 );
-    P2( C, D, E, A, B,  7,  6,  1, 12 );
-    P2( B, C, D, E, A, 12,  8,  5,  5 );
-    P2( A, B, C, D, E,  2, 13,  8, 14 );
-    P2( E, A, B, C, D, 10, 12,  7,  6 );
-    P2( D, E, A, B, C, 14,  5,  6,  8 );
-    P2( C, D, E, A, B,  1, 12,  2, 13 );
-    P2( B, C, D, E, A,  3, 13, 13,  6 );
-    P2( A, B, C, D, E,  8, 14, 14,  5 );
-    P2( E, A, B, C, D, 11, 11,  0, 15 );
-    P2( D, E, A, B, C,  6,  8,  3, 13 );
-    P2( C, D, E, A, B, 15,  5,  9, 11 );
-    P2( B, C, D, E, A, 13,  6, 11, 11 );
-#undef F
-#undef K
-#undef Fp
-#undef Kp
+#include "ripemd160_rounds.h"
 
     C             = ctx->state[1] + C + Dp;
     ctx->state[1] = ctx->state[2] + D + Ep;
@@ -341,3 +207,175 @@ void ripemd160(const uint8_t *msg, uint32_t msg_len, uint8_t hash[RIPEMD160_DIGE
     ripemd160_Update( &ctx, msg, msg_len );
     ripemd160_Final( &ctx, hash );
 }
+
+/*
+ * output = RIPEMD-160( 32-byte input ), e.g. of a sha256 digest.
+ * The message fits one block with constant padding, no context is needed.
+ */
+void ripemd160_Raw32(const uint8_t data[32], uint8_t hash[RIPEMD160_DIGEST_LENGTH])
+{
+    uint32_t A, B, C, D, E, Ap, Bp, Cp, Dp, Ep, X[16];
+    int i;
+
+    for( i = 0; i < 8; i++ )
+        GET_UINT32_LE( X[i], data, 4 * i );
+    X[ 8] = 0x80;
+    for( i = 9; i < 16; i++ )
+        X[i] = 0;
+    X[14] = 256;
+
+    A = Ap = ripemd160_initial_state[0];
+    B = Bp = ripemd160_initial_state[1];
+    C = Cp = ripemd160_initial_state[2];
+    D = Dp = ripemd160_initial_state[3];
+    E = Ep = ripemd160_initial_state[4];
+
+#include "ripemd160_rounds.h"
+
+    X[0] = ripemd160_initial_state[1] + C + Dp;
+    X[1] = ripemd160_initial_state[2] + D + Ep;
+    X[2] = ripemd160_initial_state[3] + E + Ap;
+    X[3] = ripemd160_initial_state[4] + A + Bp;
+    X[4] = ripemd160_initial_state[0] + B + Cp;
+
+    for( i = 0; i < 5; i++ )
+        PUT_UINT32_LE( X[i], hash, 4 * i );
+    memzero(X, sizeof(X));
+}
+
+#if USE_RIPEMD160_X86
+
+#define RIPEMD160_LANES 4
+#define RIPEMD160_LANES_FN ripemd160_Raw32_4way
+#define RIPEMD160_LANES_TARGET "sse2"
+#include "ripemd160_lanes.h"
+#undef RIPEMD160_LANES
+#undef RIPEMD160_LANES_FN
+#undef RIPEMD160_LANES_TARGET
+
+#define RIPEMD160_LANES 8
+#define RIPEMD160_LANES_FN ripemd160_Raw32_8way
+#define RIPEMD160_LANES_TARGET "avx2"
+#include "ripemd160_lanes.h"
+#undef RIPEMD160_LANES
+#undef RIPEMD160_LANES_FN
+#undef RIPEMD160_LANES_TARGET
+
+#define RIPEMD160_LANES 16
+#define RIPEMD160_LANES_FN ripemd160_Raw32_16way
+#define RIPEMD160_LANES_TARGET "avx512f"
+#include "ripemd160_lanes.h"
+#undef RIPEMD160_LANES
+#undef RIPEMD160_LANES_FN
+#undef RIPEMD160_LANES_TARGET
+
+static int ripemd160_lanes = 0; /* 0 - not selected yet, accessed atomically */
+static int ripemd160_lanes_once = 0; /* 0 - not selected, 1 - selecting, 2 - done */
+
+static int ripemd160_lanes_supported(int lanes)
+{
+    __builtin_cpu_init();
+    switch( lanes )
+    {
+    case 1:
+        return 1;
+    case 4:
+        return __builtin_cpu_supports("sse2");
+    case 8:
+        return __builtin_cpu_supports("avx2");
+    case 16:
+        return __builtin_cpu_supports("avx512f");
+    }
+    return 0;
+}
+
+/* Picks the widest lanes supported by the CPU unless they were set explicitly */
+static void ripemd160_lanes_select(void)
+{
+    if( __atomic_load_n( &ripemd160_lanes, __ATOMIC_ACQUIRE ) != 0 )
+        return;
+    if( !ripemd160_SetLanes( 16 ) && !ripemd160_SetLanes( 8 ) && !ripemd160_SetLanes( 4 ) )
+        ripemd160_SetLanes( 1 );
+}
+
+#endif /* USE_RIPEMD160_X86 */
+
+/*
+ * Selects how many messages ripemd160_Raw32_many hashes in parallel:
+ * 1, 4, 8 or 16. Returns 0 if the CPU doesn't support it.
+ */
+int ripemd160_SetLanes(int lanes)
+{
+#if USE_RIPEMD160_X86
+    if( !ripemd160_lanes_supported( lanes ) )
+        return 0;
+    __atomic_store_n( &ripemd160_lanes, lanes, __ATOMIC_RELEASE );
+    return 1;
+#else
+    return ( lanes == 1 );
+#endif
+}
+
+int ripemd160_GetLanes(void)
+{
+#if USE_RIPEMD160_X86
+    int lanes = __atomic_load_n( &ripemd160_lanes, __ATOMIC_ACQUIRE );
+    if( lanes == 0 )
+    {
+        /* selected once, threads calling it at the same time wait for the first one */
+        int expected = 0;
+        if( __atomic_compare_exchange_n( &ripemd160_lanes_once, &expected, 1, 0, __ATOMIC_ACQUIRE, __ATOMIC_ACQUIRE ) )
+        {
+            ripemd160_lanes_select();
+            __atomic_store_n( &ripemd160_lanes_once, 2, __ATOMIC_RELEASE );
+        }
+        while( __atomic_load_n( &ripemd160_lanes_once, __ATOMIC_ACQUIRE ) != 2 )
+        {
+        }
+        lanes = __atomic_load_n( &ripemd160_lanes, __ATOMIC_ACQUIRE );
+    }
+    return lanes;
+#else
+    return 1;
+#endif
+}
+
+/*
+ * ripemd160_Raw32 of n 32-byte messages stored one after another,
+ * digests are written one after another to hash.
+ * Hash may point to data.
+ */
+void ripemd160_Raw32_many(const uint8_t *data, size_t n, uint8_t *hash)
+{
+#if USE_RIPEMD160_X86
+    int lanes = ripemd160_GetLanes();
+    while( lanes >= 16 && n >= 16 )
+    {
+        ripemd160_Raw32_16way( data, hash );
+        data += 16 * 32;
+        hash += 16 * RIPEMD160_DIGEST_LENGTH;
+        n -= 16;
+    }
+    while( lanes >= 8 && n >= 8 )
+    {
+        ripemd160_Raw32_8way( data, hash );
+        data += 8 * 32;
+        hash += 8 * RIPEMD160_DIGEST_LENGTH;
+        n -= 8;
+    }
+    while( lanes >= 4 && n >= 4 )
+    {
+        ripemd160_Raw32_4way( data, hash );
+        data += 4 * 32;
+        hash += 4 * RIPEMD160_DIGEST_LENGTH;
+        n -= 4;
+    }
+#endif
+    while( n > 0 )
+    {
+        ripemd160_Raw32( data, hash );
+        data += 32;
+        hash += RIPEMD160_DIGEST_LENGTH;
+        n--;
+    }
+}
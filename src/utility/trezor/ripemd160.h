@@ -2,6 +2,7 @@
 #define __RIPEMD160_H__
 
 #include <stdint.h>
+#include <stddef.h>
 
 #define RIPEMD160_BLOCK_LENGTH   64
 #define RIPEMD160_DIGEST_LENGTH  20
@@ -21,6 +22,10 @@ void ripemd160_Init(RIPEMD160_CTX *ctx);
 void ripemd160_Update(RIPEMD160_CTX *ctx, const uint8_t *input, uint32_t ilen);
 void ripemd160_Final(RIPEMD160_CTX *ctx, uint8_t output[RIPEMD160_DIGEST_LENGTH]);
 void ripemd160(const uint8_t *msg, uint32_t msg_len, uint8_t hash[RIPEMD160_DIGEST_LENGTH]);
+void ripemd160_Raw32(const uint8_t data[32], uint8_t hash[RIPEMD160_DIGEST_LENGTH]);
+void ripemd160_Raw32_many(const uint8_t *data, size_t n, uint8_t *hash);
+int ripemd160_SetLanes(int lanes);
+int ripemd160_GetLanes(void);
 
 #ifdef __cplusplus
 } /* end of extern "C" */
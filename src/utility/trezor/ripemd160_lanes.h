@@ -0,0 +1,60 @@
+/*
+ * Multi-lane RIPEMD-160 kernel template, included from ripemd160.c only.
+ *
+ * Expects RIPEMD160_LANES (number of messages hashed in parallel),
+ * RIPEMD160_LANES_FN (function name) and RIPEMD160_LANES_TARGET
+ * (target attribute) to be defined. Uses GCC vector extensions,
+ * every vector element is a separate message.
+ *
+ * RIPEMD160_LANES_FN hashes RIPEMD160_LANES messages of 32 bytes each
+ * (e.g. sha256 digests), stored one after another in data, and writes
+ * RIPEMD160_LANES digests one after another to digest.
+ * Digest may overlap data.
+ */
+
+__attribute__((target(RIPEMD160_LANES_TARGET)))
+static void RIPEMD160_LANES_FN(const uint8_t *data, uint8_t *digest)
+{
+    typedef uint32_t rmd_vec __attribute__((vector_size(4 * RIPEMD160_LANES)));
+
+    rmd_vec A, B, C, D, E, Ap, Bp, Cp, Dp, Ep, X[16];
+    uint32_t w;
+    int i, l;
+
+    for( i = 0; i < 8; i++ )
+    {
+        for( l = 0; l < RIPEMD160_LANES; l++ )
+        {
+            GET_UINT32_LE( w, data, 32 * l + 4 * i );
+            X[i][l] = w;
+        }
+    }
+    /* padding of a 32-byte message is constant */
+    X[ 8] = (rmd_vec){0} + 0x80;
+    for( i = 9; i < 16; i++ )
+        X[i] = (rmd_vec){0};
+    X[14] = (rmd_vec){0} + 256;
+
+    A = Ap = (rmd_vec){0} + ripemd160_initial_state[0];
+    B = Bp = (rmd_vec){0} + ripemd160_initial_state[1];
+    C = Cp = (rmd_vec){0} + ripemd160_initial_state[2];
+    D = Dp = (rmd_vec){0} + ripemd160_initial_state[3];
+    E = Ep = (rmd_vec){0} + ripemd160_initial_state[4];
+
+#include "ripemd160_rounds.h"
+
+    X[0] = ripemd160_initial_state[1] + C + Dp;
+    X[1] = ripemd160_initial_state[2] + D + Ep;
+    X[2] = ripemd160_initial_state[3] + E + Ap;
+    X[3] = ripemd160_initial_state[4] + A + Bp;
+    X[4] = ripemd160_initial_state[0] + B + Cp;
+
+    for( l = 0; l < RIPEMD160_LANES; l++ )
+    {
+        for( i = 0; i < 5; i++ )
+        {
+            w = X[i][l];
+            PUT_UINT32_LE( w, digest, 20 * l + 4 * i );
+        }
+    }
+}
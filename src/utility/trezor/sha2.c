@@ -32,6 +32,12 @@
 #include <stdint.h>
 #include "sha2.h"
 #include "memzero.h"
+#include "options.h"
+
+#if USE_SHA2_X86
+#include <cpuid.h>
+#include <immintrin.h>
+#endif
 
 /*
  * ASSERT NOTE:
@@ -204,6 +210,27 @@ static const sha2_word32 K256[64] = {
 	0x90befffaUL, 0xa4506cebUL, 0xbef9a3f7UL, 0xc67178f2UL
 };
 
+/* K256[j] + W[j] for the padding block of a 64-byte message,
+ * the message schedule of this block is always the same */
+static const sha2_word32 sha256d64_pad_kw[64] = {
+	0xc28a2f98UL, 0x71374491UL, 0xb5c0fbcfUL, 0xe9b5dba5UL,
+	0x3956c25bUL, 0x59f111f1UL, 0x923f82a4UL, 0xab1c5ed5UL,
+	0xd807aa98UL, 0x12835b01UL, 0x243185beUL, 0x550c7dc3UL,
+	0x72be5d74UL, 0x80deb1feUL, 0x9bdc06a7UL, 0xc19bf374UL,
+	0x649b69c1UL, 0xf0fe4786UL, 0x0fe1edc6UL, 0x240cf254UL,
+	0x4fe9346fUL, 0x6cc984beUL, 0x61b9411eUL, 0x16f988faUL,
+	0xf2c65152UL, 0xa88e5a6dUL, 0xb019fc65UL, 0xb9d99ec7UL,
+	0x9a1231c3UL, 0xe70eeaa0UL, 0xfdb1232bUL, 0xc7353eb0UL,
+	0x3069bad5UL, 0xcb976d5fUL, 0x5a0f118fUL, 0xdc1eeefdUL,
+	0x0a35b689UL, 0xde0b7a04UL, 0x58f4ca9dUL, 0xe15d5b16UL,
+	0x007f3e86UL, 0x37088980UL, 0xa507ea32UL, 0x6fab9537UL,
+	0x17406110UL, 0x0d8cd6f1UL, 0xcdaa3b6dUL, 0xc0bbbe37UL,
+	0x83613bdaUL, 0xdb48a363UL, 0x0b02e931UL, 0x6fd15ca7UL,
+	0x521afacaUL, 0x31338431UL, 0x6ed41a95UL, 0x6d437890UL,
+	0xc39c91f2UL, 0x9eccabbdUL, 0xb5c9a0e6UL, 0x532fb63cUL,
+	0xd2c741c6UL, 0x07237ea3UL, 0xa4954b68UL, 0x4c191d76UL
+};
+
 /* Initial hash value H for SHA-256: */
 const sha2_word32 sha256_initial_hash_value[8] = {
 	0x6a09e667UL,
@@ -698,7 +725,7 @@ void sha256_Init(SHA256_CTX* context) {
 	(h) = T1 + Sigma0_256(a) + Maj((a), (b), (c)); \
 	j++
 
-void sha256_Transform(const sha2_word32* state_in, const sha2_word32* data, sha2_word32* state_out) {
+static void sha256_Transform_generic(const sha2_word32* state_in, const sha2_word32* data, sha2_word32* state_out) {
 	sha2_word32	a, b, c, d, e, f, g, h, s0, s1;
 	sha2_word32	T1;
 	sha2_word32 W256[16];
@@ -755,7 +782,7 @@ void sha256_Transform(const sha2_word32* state_in, const sha2_word32* data, sha2
 
 #else /* SHA2_UNROLL_TRANSFORM */
 
-void sha256_Transform(const sha2_word32* state_in, const sha2_word32* data, sha2_word32* state_out) {
+static void sha256_Transform_generic(const sha2_word32* state_in, const sha2_word32* data, sha2_word32* state_out) {
 	sha2_word32	a, b, c, d, e, f, g, h, s0, s1;
 	sha2_word32	T1, T2, W256[16];
 	int		j;
@@ -826,6 +853,243 @@ void sha256_Transform(const sha2_word32* state_in, const sha2_word32* data, sha2
 
 #endif /* SHA2_UNROLL_TRANSFORM */
 
+#if USE_SHA2_X86
+
+#ifndef bit_SHA
+#define bit_SHA (1 << 29)
+#endif
+
+/* Rounds 4*g to 4*g+3, two rounds per sha256rnds2 instruction */
+#define SHANI_ROUNDS(msg, g) \
+	MSG = _mm_add_epi32((msg), _mm_loadu_si128((const __m128i*)&K256[4*(g)])); \
+	STATE1 = _mm_sha256rnds2_epu32(STATE1, STATE0, MSG); \
+	MSG = _mm_shuffle_epi32(MSG, 0x0E); \
+	STATE0 = _mm_sha256rnds2_epu32(STATE0, STATE1, MSG)
+
+/* Message schedule: next += (cur:prev >> 32), then the sigma1 part */
+#define SHANI_SCHEDULE(cur, prev, next) \
+	TMP = _mm_alignr_epi8((cur), (prev), 4); \
+	(next) = _mm_add_epi32((next), TMP); \
+	(next) = _mm_sha256msg2_epu32((next), (cur))
+
+/* Message schedule: the sigma0 part */
+#define SHANI_SCHEDULE1(cur, prev) \
+	(prev) = _mm_sha256msg1_epu32((prev), (cur))
+
+/*
+ * data words are already in host byte order (see sha256_Update),
+ * so unlike the usual SHA-NI code no byte shuffle is needed.
+ */
+__attribute__((target("sha,sse4.1")))
+static void sha256_Transform_shani(const sha2_word32* state_in, const sha2_word32* data, sha2_word32* state_out) {
+	__m128i STATE0, STATE1, MSG, TMP, MSG0, MSG1, MSG2, MSG3, ABEF_SAVE, CDGH_SAVE;
+
+	/* state is kept as ABEF and CDGH */
+	TMP = _mm_loadu_si128((const __m128i*)&state_in[0]);
+	STATE1 = _mm_loadu_si128((const __m128i*)&state_in[4]);
+	TMP = _mm_shuffle_epi32(TMP, 0xB1);
+	STATE1 = _mm_shuffle_epi32(STATE1, 0x1B);
+	STATE0 = _mm_alignr_epi8(TMP, STATE1, 8);
+	STATE1 = _mm_blend_epi16(STATE1, TMP, 0xF0);
+	ABEF_SAVE = STATE0;
+	CDGH_SAVE = STATE1;
+
+	MSG0 = _mm_loadu_si128((const __m128i*)(data + 0));
+	MSG1 = _mm_loadu_si128((const __m128i*)(data + 4));
+	MSG2 = _mm_loadu_si128((const __m128i*)(data + 8));
+	MSG3 = _mm_loadu_si128((const __m128i*)(data + 12));
+
+	SHANI_ROUNDS(MSG0, 0);
+	SHANI_ROUNDS(MSG1, 1);
+	SHANI_SCHEDULE1(MSG1, MSG0);
+	SHANI_ROUNDS(MSG2, 2);
+	SHANI_SCHEDULE1(MSG2, MSG1);
+	SHANI_ROUNDS(MSG3, 3);
+	SHANI_SCHEDULE(MSG3, MSG2, MSG0);
+	SHANI_SCHEDULE1(MSG3, MSG2);
+
+	SHANI_ROUNDS(MSG0, 4);
+	SHANI_SCHEDULE(MSG0, MSG3, MSG1);
+	SHANI_SCHEDULE1(MSG0, MSG3);
+	SHANI_ROUNDS(MSG1, 5);
+	SHANI_SCHEDULE(MSG1, MSG0, MSG2);
+	SHANI_SCHEDULE1(MSG1, MSG0);
+	SHANI_ROUNDS(MSG2, 6);
+	SHANI_SCHEDULE(MSG2, MSG1, MSG3);
+	SHANI_SCHEDULE1(MSG2, MSG1);
+	SHANI_ROUNDS(MSG3, 7);
+	SHANI_SCHEDULE(MSG3, MSG2, MSG0);
+	SHANI_SCHEDULE1(MSG3, MSG2);
+
+	SHANI_ROUNDS(MSG0, 8);
+	SHANI_SCHEDULE(MSG0, MSG3, MSG1);
+	SHANI_SCHEDULE1(MSG0, MSG3);
+	SHANI_ROUNDS(MSG1, 9);
+	SHANI_SCHEDULE(MSG1, MSG0, MSG2);
+	SHANI_SCHEDULE1(MSG1, MSG0);
+	SHANI_ROUNDS(MSG2, 10);
+	SHANI_SCHEDULE(MSG2, MSG1, MSG3);
+	SHANI_SCHEDULE1(MSG2, MSG1);
+	SHANI_ROUNDS(MSG3, 11);
+	SHANI_SCHEDULE(MSG3, MSG2, MSG0);
+	SHANI_SCHEDULE1(MSG3, MSG2);
+
+	SHANI_ROUNDS(MSG0, 12);
+	SHANI_SCHEDULE(MSG0, MSG3, MSG1);
+	SHANI_SCHEDULE1(MSG0, MSG3);
+	SHANI_ROUNDS(MSG1, 13);
+	SHANI_SCHEDULE(MSG1, MSG0, MSG2);
+	SHANI_ROUNDS(MSG2, 14);
+	SHANI_SCHEDULE(MSG2, MSG1, MSG3);
+	SHANI_ROUNDS(MSG3, 15);
+
+	STATE0 = _mm_add_epi32(STATE0, ABEF_SAVE);
+	STATE1 = _mm_add_epi32(STATE1, CDGH_SAVE);
+
+	/* back to ABCD and EFGH */
+	TMP = _mm_shuffle_epi32(STATE0, 0x1B);
+	STATE1 = _mm_shuffle_epi32(STATE1, 0xB1);
+	STATE0 = _mm_blend_epi16(TMP, STATE1, 0xF0);
+	STATE1 = _mm_alignr_epi8(STATE1, TMP, 8);
+	_mm_storeu_si128((__m128i*)&state_out[0], STATE0);
+	_mm_storeu_si128((__m128i*)&state_out[4], STATE1);
+}
+
+/* Same as sha256_Transform_shani, but with precomputed K256 + W */
+__attribute__((target("sha,sse4.1")))
+static void sha256_Rounds_shani(const sha2_word32* state_in, const sha2_word32* kw, sha2_word32* state_out) {
+	__m128i STATE0, STATE1, MSG, TMP, ABEF_SAVE, CDGH_SAVE;
+	int g;
+
+	TMP = _mm_loadu_si128((const __m128i*)&state_in[0]);
+	STATE1 = _mm_loadu_si128((const __m128i*)&state_in[4]);
+	TMP = _mm_shuffle_epi32(TMP, 0xB1);
+	STATE1 = _mm_shuffle_epi32(STATE1, 0x1B);
+	STATE0 = _mm_alignr_epi8(TMP, STATE1, 8);
+	STATE1 = _mm_blend_epi16(STATE1, TMP, 0xF0);
+	ABEF_SAVE = STATE0;
+	CDGH_SAVE = STATE1;
+
+	for (g = 0; g < 16; g++) {
+		MSG = _mm_loadu_si128((const __m128i*)&kw[4*g]);
+		STATE1 = _mm_sha256rnds2_epu32(STATE1, STATE0, MSG);
+		MSG = _mm_shuffle_epi32(MSG, 0x0E);
+		STATE0 = _mm_sha256rnds2_epu32(STATE0, STATE1, MSG);
+	}
+
+	STATE0 = _mm_add_epi32(STATE0, ABEF_SAVE);
+	STATE1 = _mm_add_epi32(STATE1, CDGH_SAVE);
+
+	TMP = _mm_shuffle_epi32(STATE0, 0x1B);
+	STATE1 = _mm_shuffle_epi32(STATE1, 0xB1);
+	STATE0 = _mm_blend_epi16(TMP, STATE1, 0xF0);
+	STATE1 = _mm_alignr_epi8(STATE1, TMP, 8);
+	_mm_storeu_si128((__m128i*)&state_out[0], STATE0);
+	_mm_storeu_si128((__m128i*)&state_out[4], STATE1);
+}
+
+static int sha256_shani_supported(void) {
+	unsigned int eax, ebx, ecx, edx;
+	if (!__get_cpuid(1, &eax, &ebx, &ecx, &edx) || !(ecx & bit_SSE4_1)) {
+		return 0;
+	}
+	if (__get_cpuid_max(0, NULL) < 7) {
+		return 0;
+	}
+	__cpuid_count(7, 0, eax, ebx, ecx, edx);
+	return (ebx & bit_SHA) != 0;
+}
+
+/*
+ * Runs select() once. Threads calling it at the same time
+ * wait until the first one is done, so dispatch variables
+ * are never chosen by several threads in parallel.
+ * state: 0 - not selected, 1 - selecting, 2 - done
+ */
+static void sha2_once(int *state, void (*select)(void)) {
+	int expected = 0;
+	if (__atomic_load_n(state, __ATOMIC_ACQUIRE) == 2) {
+		return;
+	}
+	if (__atomic_compare_exchange_n(state, &expected, 1, 0, __ATOMIC_ACQUIRE, __ATOMIC_ACQUIRE)) {
+		select();
+		__atomic_store_n(state, 2, __ATOMIC_RELEASE);
+		return;
+	}
+	while (__atomic_load_n(state, __ATOMIC_ACQUIRE) != 2) {
+	}
+}
+
+static void sha256_Transform_detect(const sha2_word32* state_in, const sha2_word32* data, sha2_word32* state_out);
+
+typedef void (*sha256_transform_fn)(const sha2_word32*, const sha2_word32*, sha2_word32*);
+/* accessed atomically, sha256_SetTransform can be called while other threads hash */
+static sha256_transform_fn sha256_transform_impl = sha256_Transform_detect;
+static int sha256_transform_id = SHA256_TRANSFORM_GENERIC;
+static int sha256_transform_once = 0;
+
+/* Picks the fastest implementation supported by the CPU unless it was set explicitly */
+static void sha256_Transform_select(void) {
+	if (__atomic_load_n(&sha256_transform_impl, __ATOMIC_ACQUIRE) != sha256_Transform_detect) {
+		return;
+	}
+	if (!sha256_SetTransform(SHA256_TRANSFORM_SHANI)) {
+		sha256_SetTransform(SHA256_TRANSFORM_GENERIC);
+	}
+}
+
+static void sha256_Transform_detect(const sha2_word32* state_in, const sha2_word32* data, sha2_word32* state_out) {
+	sha2_once(&sha256_transform_once, sha256_Transform_select);
+	__atomic_load_n(&sha256_transform_impl, __ATOMIC_ACQUIRE)(state_in, data, state_out);
+}
+
+/* Selects compression function, returns 0 if the CPU doesn't support it */
+int sha256_SetTransform(int impl) {
+	sha256_transform_fn fn;
+	switch (impl) {
+	case SHA256_TRANSFORM_GENERIC:
+		fn = sha256_Transform_generic;
+		break;
+	case SHA256_TRANSFORM_SHANI:
+		if (!sha256_shani_supported()) {
+			return 0;
+		}
+		fn = sha256_Transform_shani;
+		break;
+	default:
+		return 0;
+	}
+	/* id first, so it is up to date once the new function is visible */
+	__atomic_store_n(&sha256_transform_id, impl, __ATOMIC_RELEASE);
+	__atomic_store_n(&sha256_transform_impl, fn, __ATOMIC_RELEASE);
+	return 1;
+}
+
+int sha256_GetTransform(void) {
+	sha2_once(&sha256_transform_once, sha256_Transform_select);
+	return __atomic_load_n(&sha256_transform_id, __ATOMIC_ACQUIRE);
+}
+
+void sha256_Transform(const sha2_word32* state_in, const sha2_word32* data, sha2_word32* state_out) {
+	__atomic_load_n(&sha256_transform_impl, __ATOMIC_ACQUIRE)(state_in, data, state_out);
+}
+
+#else /* USE_SHA2_X86 */
+
+int sha256_SetTransform(int impl) {
+	return (impl == SHA256_TRANSFORM_GENERIC);
+}
+
+int sha256_GetTransform(void) {
+	return SHA256_TRANSFORM_GENERIC;
+}
+
+void sha256_Transform(const sha2_word32* state_in, const sha2_word32* data, sha2_word32* state_out) {
+	sha256_Transform_generic(state_in, data, state_out);
+}
+
+#endif /* USE_SHA2_X86 */
+
 void sha256_Update(SHA256_CTX* context, const sha2_byte *data, size_t len) {
 	unsigned int	freespace, usedspace;
 
@@ -965,6 +1229,287 @@ void sha256_Raw(const sha2_byte* data, size_t len, uint8_t digest[SHA256_DIGEST_
 	sha256_Final(&context, digest);
 }
 
+/*** SHA-256 of many messages: *****************************************/
+
+#if USE_SHA2_X86
+
+/* Fills words with block n of the padded message, in host byte order */
+static void sha256_lane_block(const sha2_byte *msg, size_t len, size_t n, sha2_word32 words[16]) {
+	sha2_byte	buf[SHA256_BLOCK_LENGTH];
+	size_t		off = n * SHA256_BLOCK_LENGTH;
+	sha2_word64	bits = ((sha2_word64)len) << 3;
+	int		i;
+
+	memzero(buf, SHA256_BLOCK_LENGTH);
+	if (off < len) {
+		MEMCPY_BCOPY(buf, msg + off, (len - off < SHA256_BLOCK_LENGTH) ? len - off : SHA256_BLOCK_LENGTH);
+	}
+	if (len >= off && len < off + SHA256_BLOCK_LENGTH) {
+		buf[len - off] = 0x80;
+	}
+	if (n == (len + 8) / SHA256_BLOCK_LENGTH) { /* last block */
+		for (i = 0; i < 8; i++) {
+			buf[SHA256_BLOCK_LENGTH - 1 - i] = (sha2_byte)(bits >> (8*i));
+		}
+	}
+	for (i = 0; i < 16; i++) {
+		words[i] = ((sha2_word32)buf[4*i] << 24) | ((sha2_word32)buf[4*i+1] << 16) |
+		           ((sha2_word32)buf[4*i+2] << 8) | (sha2_word32)buf[4*i+3];
+	}
+	memzero(buf, sizeof(buf));
+}
+
+#define SHA2_LANES 4
+#define SHA2_LANES_FN sha256_Raw_4way
+#define SHA2_LANES_D64_FN sha256d64_Raw_4way
+#define SHA2_LANES_TARGET "sse2"
+#include "sha2_lanes.h"
+#undef SHA2_LANES
+#undef SHA2_LANES_FN
+#undef SHA2_LANES_D64_FN
+#undef SHA2_LANES_TARGET
+
+#define SHA2_LANES 8
+#define SHA2_LANES_FN sha256_Raw_8way
+#define SHA2_LANES_D64_FN sha256d64_Raw_8way
+#define SHA2_LANES_TARGET "avx2"
+#include "sha2_lanes.h"
+#undef SHA2_LANES
+#undef SHA2_LANES_FN
+#undef SHA2_LANES_D64_FN
+#undef SHA2_LANES_TARGET
+
+#define SHA2_LANES 16
+#define SHA2_LANES_FN sha256_Raw_16way
+#define SHA2_LANES_D64_FN sha256d64_Raw_16way
+#define SHA2_LANES_TARGET "avx512f"
+#include "sha2_lanes.h"
+#undef SHA2_LANES
+#undef SHA2_LANES_FN
+#undef SHA2_LANES_D64_FN
+#undef SHA2_LANES_TARGET
+
+static int sha256_lanes = 0; /* 0 - not selected yet, accessed atomically */
+static int sha256_lanes_once = 0;
+
+static int sha256_lanes_supported(int lanes) {
+	__builtin_cpu_init();
+	switch (lanes) {
+	case 1:
+		return 1;
+	case 4:
+		return __builtin_cpu_supports("sse2");
+	case 8:
+		return __builtin_cpu_supports("avx2");
+	case 16:
+		return __builtin_cpu_supports("avx512f");
+	}
+	return 0;
+}
+
+/* Picks the widest lanes supported by the CPU unless they were set explicitly */
+static void sha256_lanes_select(void) {
+	if (__atomic_load_n(&sha256_lanes, __ATOMIC_ACQUIRE) != 0) {
+		return;
+	}
+	/* SHA extensions are faster than 4 or 8 lanes */
+	if (sha256_GetTransform() == SHA256_TRANSFORM_SHANI) {
+		if (!sha256_SetLanes(16)) {
+			sha256_SetLanes(1);
+		}
+	} else if (!sha256_SetLanes(16) && !sha256_SetLanes(8) && !sha256_SetLanes(4)) {
+		sha256_SetLanes(1);
+	}
+}
+
+#endif /* USE_SHA2_X86 */
+
+/*
+ * Selects how many messages sha256_Raw_many hashes in parallel:
+ * 1 (one by one with sha256_Transform), 4, 8 or 16.
+ * Returns 0 if the CPU doesn't support it.
+ */
+int sha256_SetLanes(int lanes) {
+#if USE_SHA2_X86
+	if (!sha256_lanes_supported(lanes)) {
+		return 0;
+	}
+	__atomic_store_n(&sha256_lanes, lanes, __ATOMIC_RELEASE);
+	return 1;
+#else
+	return (lanes == 1);
+#endif
+}
+
+int sha256_GetLanes(void) {
+#if USE_SHA2_X86
+	int lanes = __atomic_load_n(&sha256_lanes, __ATOMIC_ACQUIRE);
+	if (lanes == 0) {
+		sha2_once(&sha256_lanes_once, sha256_lanes_select);
+		lanes = __atomic_load_n(&sha256_lanes, __ATOMIC_ACQUIRE);
+	}
+	return lanes;
+#else
+	return 1;
+#endif
+}
+
+/*
+ * Hashes n messages of len bytes each stored one after another in data,
+ * digests are written one after another to digest.
+ * Digest may overlap data if len is SHA256_DIGEST_LENGTH.
+ */
+void sha256_Raw_many(const sha2_byte* data, size_t len, size_t n, sha2_byte* digest) {
+#if USE_SHA2_X86
+	int lanes = sha256_GetLanes();
+	while (lanes >= 16 && n >= 16) {
+		sha256_Raw_16way(data, len, digest);
+		data += 16 * len;
+		digest += 16 * SHA256_DIGEST_LENGTH;
+		n -= 16;
+	}
+	while (lanes >= 8 && n >= 8) {
+		sha256_Raw_8way(data, len, digest);
+		data += 8 * len;
+		digest += 8 * SHA256_DIGEST_LENGTH;
+		n -= 8;
+	}
+	while (lanes >= 4 && n >= 4) {
+		sha256_Raw_4way(data, len, digest);
+		data += 4 * len;
+		digest += 4 * SHA256_DIGEST_LENGTH;
+		n -= 4;
+	}
+#endif
+	while (n > 0) {
+		sha256_Raw(data, len, digest);
+		data += len;
+		digest += SHA256_DIGEST_LENGTH;
+		n--;
+	}
+}
+
+/*** Double SHA-256 of 64-byte messages: *******************************/
+
+/* Compression function with precomputed K256 + W, no message schedule */
+static void sha256_Rounds_generic(const sha2_word32* state_in, const sha2_word32* kw, sha2_word32* state_out) {
+	sha2_word32	a, b, c, d, e, f, g, h;
+	sha2_word32	T1, T2;
+	int		j;
+
+	a = state_in[0];
+	b = state_in[1];
+	c = state_in[2];
+	d = state_in[3];
+	e = state_in[4];
+	f = state_in[5];
+	g = state_in[6];
+	h = state_in[7];
+
+	for (j = 0; j < 64; j++) {
+		T1 = h + Sigma1_256(e) + Ch(e, f, g) + kw[j];
+		T2 = Sigma0_256(a) + Maj(a, b, c);
+		h = g;
+		g = f;
+		f = e;
+		e = d + T1;
+		d = c;
+		c = b;
+		b = a;
+		a = T1 + T2;
+	}
+
+	state_out[0] = state_in[0] + a;
+	state_out[1] = state_in[1] + b;
+	state_out[2] = state_in[2] + c;
+	state_out[3] = state_in[3] + d;
+	state_out[4] = state_in[4] + e;
+	state_out[5] = state_in[5] + f;
+	state_out[6] = state_in[6] + g;
+	state_out[7] = state_in[7] + h;
+
+	a = b = c = d = e = f = g = h = T1 = T2 = 0;
+}
+
+/*
+ * sha256(sha256(data)) for exactly 64 bytes of data, e.g. a merkle node.
+ * The padding block and the padding of the second hash are constant,
+ * so their message schedule is precomputed.
+ */
+void sha256d64_Raw(const sha2_byte* data, sha2_byte digest[SHA256_DIGEST_LENGTH]) {
+	sha2_word32	W256[16], state[8];
+	int		j;
+
+	for (j = 0; j < 16; j++) {
+		W256[j] = ((sha2_word32)data[4*j] << 24) | ((sha2_word32)data[4*j+1] << 16) |
+		          ((sha2_word32)data[4*j+2] << 8) | (sha2_word32)data[4*j+3];
+	}
+	sha256_Transform(sha256_initial_hash_value, W256, state);
+#if USE_SHA2_X86
+	if (sha256_GetTransform() == SHA256_TRANSFORM_SHANI) {
+		sha256_Rounds_shani(state, sha256d64_pad_kw, state);
+	} else {
+		sha256_Rounds_generic(state, sha256d64_pad_kw, state);
+	}
+#else
+	sha256_Rounds_generic(state, sha256d64_pad_kw, state);
+#endif
+
+	for (j = 0; j < 8; j++) {
+		W256[j] = state[j];
+	}
+	W256[8] = 0x80000000UL;
+	for (j = 9; j < 15; j++) {
+		W256[j] = 0;
+	}
+	W256[15] = 256;
+	sha256_Transform(sha256_initial_hash_value, W256, state);
+
+	for (j = 0; j < 8; j++) {
+		digest[4*j + 0] = (sha2_byte)(state[j] >> 24);
+		digest[4*j + 1] = (sha2_byte)(state[j] >> 16);
+		digest[4*j + 2] = (sha2_byte)(state[j] >> 8);
+		digest[4*j + 3] = (sha2_byte)state[j];
+	}
+	memzero(W256, sizeof(W256));
+	memzero(state, sizeof(state));
+}
+
+/*
+ * sha256d64_Raw of n messages stored one after another,
+ * e.g. n pairs of merkle nodes of one tree level.
+ * Digest may point to data, then the next level replaces the current one.
+ */
+void sha256d64_Raw_many(const sha2_byte* data, size_t n, sha2_byte* digest) {
+#if USE_SHA2_X86
+	int lanes = sha256_GetLanes();
+	while (lanes >= 16 && n >= 16) {
+		sha256d64_Raw_16way(data, digest);
+		data += 16 * 64;
+		digest += 16 * SHA256_DIGEST_LENGTH;
+		n -= 16;
+	}
+	while (lanes >= 8 && n >= 8) {
+		sha256d64_Raw_8way(data, digest);
+		data += 8 * 64;
+		digest += 8 * SHA256_DIGEST_LENGTH;
+		n -= 8;
+	}
+	while (lanes >= 4 && n >= 4) {
+		sha256d64_Raw_4way(data, digest);
+		data += 4 * 64;
+		digest += 4 * SHA256_DIGEST_LENGTH;
+		n -= 4;
+	}
+#endif
+	while (n > 0) {
+		sha256d64_Raw(data, digest);
+		data += 64;
+		digest += SHA256_DIGEST_LENGTH;
+		n--;
+	}
+}
+
 char* sha256_Data(const sha2_byte* data, size_t len, char digest[SHA256_DIGEST_STRING_LENGTH]) {
 	SHA256_CTX	context;
 
@@ -1281,3 +1826,72 @@ char* sha512_Data(const sha2_byte* data, size_t len, char digest[SHA512_DIGEST_S
 	sha512_Update(&context, data, len);
 	return sha512_End(&context, digest);
 }
+
+/*** SHA-512 HMAC iterations for many keys: *****************************/
+
+#if USE_SHA2_X86
+
+#define SHA512_LANES 4
+#define SHA512_LANES_FN sha512_HmacIterate_4way
+#define SHA512_LANES_TARGET "avx2"
+#include "sha512_lanes.h"
+#undef SHA512_LANES
+#undef SHA512_LANES_FN
+#undef SHA512_LANES_TARGET
+
+#define SHA512_LANES 8
+#define SHA512_LANES_FN sha512_HmacIterate_8way
+#define SHA512_LANES_TARGET "avx512f"
+#include "sha512_lanes.h"
+#undef SHA512_LANES
+#undef SHA512_LANES_FN
+#undef SHA512_LANES_TARGET
+
+#endif /* USE_SHA2_X86 */
+
+/*
+ * PBKDF2-HMAC-SHA512 inner loop for n independent keys.
+ * For every key runs iterations times:
+ *   dig = HMAC(key, dig); fsum ^= dig
+ * where HMAC is computed from the key pad midstates idig and odig
+ * (see hmac_sha512_prepare). All arrays hold n * 8 words in host byte
+ * order, one key after another. On x86 hosts 4 or 8 keys are
+ * processed in parallel with AVX2 or AVX-512.
+ */
+void sha512_HmacIterate_many(const uint64_t* idig, const uint64_t* odig, uint64_t* fsum, uint64_t* dig, size_t n, uint32_t iterations) {
+	sha2_word64	block[16];
+	uint32_t	it;
+	int		j;
+
+#if USE_SHA2_X86
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("avx512f")) {
+		for (; n >= 8; n -= 8) {
+			sha512_HmacIterate_8way(idig, odig, fsum, dig, iterations);
+			idig += 64; odig += 64; fsum += 64; dig += 64;
+		}
+	}
+	if (__builtin_cpu_supports("avx2")) {
+		for (; n >= 4; n -= 4) {
+			sha512_HmacIterate_4way(idig, odig, fsum, dig, iterations);
+			idig += 32; odig += 32; fsum += 32; dig += 32;
+		}
+	}
+#endif
+	for (; n > 0; n--) {
+		memzero(block, sizeof(block));
+		memcpy(block, dig, SHA512_DIGEST_LENGTH);
+		block[8] = 0x8000000000000000ULL;
+		block[15] = (SHA512_BLOCK_LENGTH + SHA512_DIGEST_LENGTH) * 8;
+		for (it = 0; it < iterations; it++) {
+			sha512_Transform(idig, block, block);
+			sha512_Transform(odig, block, block);
+			for (j = 0; j < 8; j++) {
+				fsum[j] ^= block[j];
+			}
+		}
+		memcpy(dig, block, SHA512_DIGEST_LENGTH);
+		idig += 8; odig += 8; fsum += 8; dig += 8;
+	}
+	memzero(block, sizeof(block));
+}
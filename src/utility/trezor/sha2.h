@@ -86,6 +86,10 @@ typedef struct _SHA512_CTX {
 }
 #endif /* BYTE_ORDER == LITTLE_ENDIAN */
 
+/*** SHA-256 COMPRESSION FUNCTION IMPLEMENTATIONS ********************/
+#define SHA256_TRANSFORM_GENERIC 0 /* portable C */
+#define SHA256_TRANSFORM_SHANI   1 /* x86 SHA extensions */
+
 extern const uint32_t sha256_initial_hash_value[8];
 extern const uint64_t sha512_initial_hash_value[8];
 
@@ -103,12 +107,19 @@ void sha1_Raw(const uint8_t*, size_t, uint8_t[SHA1_DIGEST_LENGTH]);
 char* sha1_Data(const uint8_t*, size_t, char[SHA1_DIGEST_STRING_LENGTH]);
 
 void sha256_Transform(const uint32_t* state_in, const uint32_t* data, uint32_t* state_out);
+int sha256_SetTransform(int impl);
+int sha256_GetTransform(void);
 void sha256_Init(SHA256_CTX *);
 void sha256_Update(SHA256_CTX*, const uint8_t*, size_t);
 void sha256_Final(SHA256_CTX*, uint8_t[SHA256_DIGEST_LENGTH]);
 char* sha256_End(SHA256_CTX*, char[SHA256_DIGEST_STRING_LENGTH]);
 void sha256_Raw(const uint8_t*, size_t, uint8_t[SHA256_DIGEST_LENGTH]);
 char* sha256_Data(const uint8_t*, size_t, char[SHA256_DIGEST_STRING_LENGTH]);
+void sha256_Raw_many(const uint8_t* data, size_t len, size_t n, uint8_t* digest);
+int sha256_SetLanes(int lanes);
+int sha256_GetLanes(void);
+void sha256d64_Raw(const uint8_t* data, uint8_t digest[SHA256_DIGEST_LENGTH]);
+void sha256d64_Raw_many(const uint8_t* data, size_t n, uint8_t* digest);
 
 void sha512_Transform(const uint64_t* state_in, const uint64_t* data, uint64_t* state_out);
 void sha512_Init(SHA512_CTX*);
@@ -117,6 +128,7 @@ void sha512_Final(SHA512_CTX*, uint8_t[SHA512_DIGEST_LENGTH]);
 char* sha512_End(SHA512_CTX*, char[SHA512_DIGEST_STRING_LENGTH]);
 void sha512_Raw(const uint8_t*, size_t, uint8_t[SHA512_DIGEST_LENGTH]);
 char* sha512_Data(const uint8_t*, size_t, char[SHA512_DIGEST_STRING_LENGTH]);
+void sha512_HmacIterate_many(const uint64_t* idig, const uint64_t* odig, uint64_t* fsum, uint64_t* dig, size_t n, uint32_t iterations);
 
 #ifdef __cplusplus
 } /* end of extern "C" */
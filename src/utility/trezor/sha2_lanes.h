@@ -0,0 +1,159 @@
+/*
+ * Multi-lane SHA-256 kernel template, included from sha2.c only.
+ *
+ * Expects SHA2_LANES (number of messages hashed in parallel),
+ * SHA2_LANES_FN and SHA2_LANES_D64_FN (function names) and
+ * SHA2_LANES_TARGET (target attribute) to be defined. Uses GCC vector extensions, every vector element is
+ * a separate message.
+ *
+ * SHA2_LANES_FN hashes SHA2_LANES messages of len bytes each,
+ * stored one after another in data, and writes SHA2_LANES digests
+ * one after another to digest. Digest may overlap data if len is 32.
+ *
+ * SHA2_LANES_D64_FN does the same for double SHA-256 of 64-byte messages.
+ */
+
+/* One round, kw is K256[j] + W[j] */
+#define SHA2_LANES_ROUND(kw) \
+	T1 = h + Sigma1_256(e) + Ch(e, f, g) + (kw); \
+	T2 = Sigma0_256(a) + Maj(a, b, c); \
+	h = g; \
+	g = f; \
+	f = e; \
+	e = d + T1; \
+	d = c; \
+	c = b; \
+	b = a; \
+	a = T1 + T2
+
+/* Loads state to working variables */
+#define SHA2_LANES_LOAD(st) \
+	a = (st)[0]; \
+	b = (st)[1]; \
+	c = (st)[2]; \
+	d = (st)[3]; \
+	e = (st)[4]; \
+	f = (st)[5]; \
+	g = (st)[6]; \
+	h = (st)[7]
+
+/* Adds working variables to the state */
+#define SHA2_LANES_ADD(st) \
+	(st)[0] += a; \
+	(st)[1] += b; \
+	(st)[2] += c; \
+	(st)[3] += d; \
+	(st)[4] += e; \
+	(st)[5] += f; \
+	(st)[6] += g; \
+	(st)[7] += h
+
+/* 64 rounds with message schedule in W256 */
+#define SHA2_LANES_ROUNDS() \
+	for (j = 0; j < 64; j++) { \
+		if (j >= 16) { \
+			s0 = sigma0_256(W256[(j+1)&0x0f]); \
+			s1 = sigma1_256(W256[(j+14)&0x0f]); \
+			W256[j&0x0f] += s1 + W256[(j+9)&0x0f] + s0; \
+		} \
+		SHA2_LANES_ROUND(K256[j] + W256[j&0x0f]); \
+	}
+
+/* Writes state of every lane as big-endian digest */
+#define SHA2_LANES_STORE(st, out) \
+	for (l = 0; l < SHA2_LANES; l++) { \
+		for (i = 0; i < 8; i++) { \
+			sha2_word32 w = (st)[i][l]; \
+			(out)[32*l + 4*i + 0] = (sha2_byte)(w >> 24); \
+			(out)[32*l + 4*i + 1] = (sha2_byte)(w >> 16); \
+			(out)[32*l + 4*i + 2] = (sha2_byte)(w >> 8); \
+			(out)[32*l + 4*i + 3] = (sha2_byte)w; \
+		} \
+	}
+
+__attribute__((target(SHA2_LANES_TARGET)))
+static void SHA2_LANES_FN(const sha2_byte *data, size_t len, sha2_byte *digest) {
+	typedef sha2_word32 sha2_vec __attribute__((vector_size(4 * SHA2_LANES)));
+
+	sha2_vec	state[8], W256[16];
+	sha2_vec	a, b, c, d, e, f, g, h, s0, s1, T1, T2;
+	sha2_word32	block[SHA2_LANES][16];
+	size_t		blocks = (len + 8) / SHA256_BLOCK_LENGTH + 1;
+	size_t		n;
+	int		i, j, l;
+
+	for (i = 0; i < 8; i++) {
+		state[i] = (sha2_vec){0} + sha256_initial_hash_value[i];
+	}
+
+	for (n = 0; n < blocks; n++) {
+		for (l = 0; l < SHA2_LANES; l++) {
+			sha256_lane_block(data + l * len, len, n, block[l]);
+		}
+		for (j = 0; j < 16; j++) {
+			for (l = 0; l < SHA2_LANES; l++) {
+				W256[j][l] = block[l][j];
+			}
+		}
+
+		SHA2_LANES_LOAD(state);
+		SHA2_LANES_ROUNDS();
+		SHA2_LANES_ADD(state);
+	}
+
+	SHA2_LANES_STORE(state, digest);
+	memzero(block, sizeof(block));
+}
+
+__attribute__((target(SHA2_LANES_TARGET)))
+static void SHA2_LANES_D64_FN(const sha2_byte *data, sha2_byte *digest) {
+	typedef sha2_word32 sha2_vec __attribute__((vector_size(4 * SHA2_LANES)));
+
+	sha2_vec	state[8], W256[16];
+	sha2_vec	a, b, c, d, e, f, g, h, s0, s1, T1, T2;
+	int		i, j, l;
+
+	/* first block of the first hash: the message itself */
+	for (j = 0; j < 16; j++) {
+		for (l = 0; l < SHA2_LANES; l++) {
+			const sha2_byte *p = data + 64*l + 4*j;
+			W256[j][l] = ((sha2_word32)p[0] << 24) | ((sha2_word32)p[1] << 16) |
+			             ((sha2_word32)p[2] << 8) | (sha2_word32)p[3];
+		}
+	}
+	for (i = 0; i < 8; i++) {
+		state[i] = (sha2_vec){0} + sha256_initial_hash_value[i];
+	}
+	SHA2_LANES_LOAD(state);
+	SHA2_LANES_ROUNDS();
+	SHA2_LANES_ADD(state);
+
+	/* second block: padding, the message schedule is constant */
+	SHA2_LANES_LOAD(state);
+	for (j = 0; j < 64; j++) {
+		SHA2_LANES_ROUND(sha256d64_pad_kw[j]);
+	}
+	SHA2_LANES_ADD(state);
+
+	/* second hash of the 32-byte digest, words 8..15 are padding */
+	for (i = 0; i < 8; i++) {
+		W256[i] = state[i];
+		state[i] = (sha2_vec){0} + sha256_initial_hash_value[i];
+	}
+	W256[8] = (sha2_vec){0} + 0x80000000UL;
+	for (i = 9; i < 15; i++) {
+		W256[i] = (sha2_vec){0};
+	}
+	W256[15] = (sha2_vec){0} + 256;
+	SHA2_LANES_LOAD(state);
+	SHA2_LANES_ROUNDS();
+	SHA2_LANES_ADD(state);
+
+	SHA2_LANES_STORE(state, digest);
+}
+
+#undef SHA2_LANES_ROUND
+#undef SHA2_LANES_LOAD
+#undef SHA2_LANES_ADD
+#undef SHA2_LANES_ROUNDS
+#undef SHA2_LANES_STORE
@@ -0,0 +1,105 @@
+/*
+ * Multi-lane SHA-512 HMAC iteration kernel template, included from sha2.c only.
+ *
+ * Expects SHA512_LANES (number of independent lanes),
+ * SHA512_LANES_FN (function name) and SHA512_LANES_TARGET
+ * (target attribute) to be defined. Uses GCC vector extensions,
+ * every vector element is a separate lane.
+ *
+ * See sha512_HmacIterate_many for the meaning of arguments,
+ * the function processes exactly SHA512_LANES lanes.
+ */
+
+/* 80 rounds of block W512 on top of state st, result is added to st */
+#define SHA512_LANES_BLOCK(st) \
+	a = (st)[0]; \
+	b = (st)[1]; \
+	c = (st)[2]; \
+	d = (st)[3]; \
+	e = (st)[4]; \
+	f = (st)[5]; \
+	g = (st)[6]; \
+	h = (st)[7]; \
+	for (j = 0; j < 80; j++) { \
+		if (j >= 16) { \
+			s0 = sigma0_512(W512[(j+1)&0x0f]); \
+			s1 = sigma1_512(W512[(j+14)&0x0f]); \
+			W512[j&0x0f] += s1 + W512[(j+9)&0x0f] + s0; \
+		} \
+		T1 = h + Sigma1_512(e) + Ch(e, f, g) + K512[j] + W512[j&0x0f]; \
+		T2 = Sigma0_512(a) + Maj(a, b, c); \
+		h = g; \
+		g = f; \
+		f = e; \
+		e = d + T1; \
+		d = c; \
+		c = b; \
+		b = a; \
+		a = T1 + T2; \
+	} \
+	(st)[0] += a; \
+	(st)[1] += b; \
+	(st)[2] += c; \
+	(st)[3] += d; \
+	(st)[4] += e; \
+	(st)[5] += f; \
+	(st)[6] += g; \
+	(st)[7] += h
+
+/* W512 = digest of 64 bytes padded as a message following one key pad block */
+#define SHA512_LANES_DIGEST_BLOCK(dig) \
+	for (i = 0; i < 8; i++) { \
+		W512[i] = (dig)[i]; \
+	} \
+	W512[8] = (sha512_vec){0} + 0x8000000000000000ULL; \
+	for (i = 9; i < 15; i++) { \
+		W512[i] = (sha512_vec){0}; \
+	} \
+	W512[15] = (sha512_vec){0} + (SHA512_BLOCK_LENGTH + SHA512_DIGEST_LENGTH) * 8
+
+__attribute__((target(SHA512_LANES_TARGET)))
+static void SHA512_LANES_FN(const sha2_word64 *idig, const sha2_word64 *odig, sha2_word64 *fsum, sha2_word64 *dig, uint32_t iterations) {
+	typedef sha2_word64 sha512_vec __attribute__((vector_size(8 * SHA512_LANES)));
+
+	sha512_vec	I[8], O[8], F[8], G[8], S[8], W512[16];
+	sha512_vec	a, b, c, d, e, f, g, h, s0, s1, T1, T2;
+	uint32_t	n;
+	int		i, j, l;
+
+	for (i = 0; i < 8; i++) {
+		for (l = 0; l < SHA512_LANES; l++) {
+			I[i][l] = idig[8*l + i];
+			O[i][l] = odig[8*l + i];
+			F[i][l] = fsum[8*l + i];
+			G[i][l] = dig[8*l + i];
+		}
+	}
+
+	for (n = 0; n < iterations; n++) {
+		/* inner hash */
+		SHA512_LANES_DIGEST_BLOCK(G);
+		for (i = 0; i < 8; i++) {
+			S[i] = I[i];
+		}
+		SHA512_LANES_BLOCK(S);
+		/* outer hash */
+		SHA512_LANES_DIGEST_BLOCK(S);
+		for (i = 0; i < 8; i++) {
+			G[i] = O[i];
+		}
+		SHA512_LANES_BLOCK(G);
+		for (i = 0; i < 8; i++) {
+			F[i] ^= G[i];
+		}
+	}
+
+	for (i = 0; i < 8; i++) {
+		for (l = 0; l < SHA512_LANES; l++) {
+			fsum[8*l + i] = F[i][l];
+			dig[8*l + i] = G[i][l];
+		}
+	}
+}
+
+#undef SHA512_LANES_BLOCK
+#undef SHA512_LANES_DIGEST_BLOCK